@@ -0,0 +1,73 @@
+#!/bin/sh
+# Zero-allocation check for the shared-memory main frame and trucks.
+#
+# Builds both programs with -DPLATOON_ALLOC_CHECK, runs a main frame, a
+# leader and a three-truck swarm, then kills the leader so the swarm goes
+# through a failover. Each checked process exits 0 once its loops have run
+# ITERATIONS clean iterations (after the last role change, for the swarm)
+# and aborts on the first allocation after warm-up.
+#
+# Usage: Use_Cases/alloc_check.sh      exits 0 on pass, non-zero on failure
+#
+# Uses the default shared memory segment, so nothing else may be running.
+
+ITERATIONS=${ITERATIONS:-15}
+HERE=$(cd "$(dirname "$0")" && pwd)
+CXX=${CXX:-g++}
+
+CHECKPOINT=/tmp/main_frame_checkpoint.bin
+if [ -e /dev/shm/main_frame_memory ] || [ -e $CHECKPOINT ]; then
+    echo "alloc_check: a platoon segment or checkpoint already exists, stop it and remove them first" >&2
+    exit 1
+fi
+
+WORK=$(mktemp -d)
+cleanup() {
+    kill -9 $MAIN_PID $LEADER_PID $SWARM_PID 2>/dev/null
+    rm -rf "$WORK"
+    rm -f /dev/shm/main_frame_memory $CHECKPOINT $CHECKPOINT.tmp
+}
+trap cleanup EXIT
+
+ln -s "$HERE/common_use.cpp" "$WORK/common.h"
+for prog in mainframe_use truck_use; do
+    $CXX -std=c++20 -O2 -DPLATOON_ALLOC_CHECK -I"$WORK" "$HERE/$prog.cpp" \
+        -o "$WORK/$prog" -lpthread -lrt || exit 1
+done
+
+PLATOON_ALLOC_CHECK_ITERATIONS=$ITERATIONS "$WORK/mainframe_use" < /dev/null > "$WORK/main.log" 2>&1 &
+MAIN_PID=$!
+sleep 1
+"$WORK/truck_use" 0 l < /dev/null > "$WORK/leader.log" 2>&1 &
+LEADER_PID=$!
+sleep 1
+PLATOON_ALLOC_CHECK_ITERATIONS=$ITERATIONS "$WORK/truck_use" 1 s 3 < /dev/null > "$WORK/swarm.log" 2>&1 &
+SWARM_PID=$!
+
+# Let the swarm settle in as followers, then take the leader away
+sleep 4
+kill -9 $LEADER_PID
+
+wait $SWARM_PID
+SWARM_STATUS=$?
+wait $MAIN_PID
+MAIN_STATUS=$?
+
+status=0
+if [ $MAIN_STATUS -ne 0 ]; then
+    echo "FAIL: main frame exited with $MAIN_STATUS" >&2
+    tail -n 5 "$WORK/main.log" >&2
+    status=1
+fi
+if [ $SWARM_STATUS -ne 0 ]; then
+    echo "FAIL: swarm exited with $SWARM_STATUS" >&2
+    tail -n 5 "$WORK/swarm.log" >&2
+    status=1
+fi
+if ! grep -q "taking over" "$WORK/swarm.log"; then
+    echo "FAIL: no failover happened in the swarm" >&2
+    status=1
+fi
+grep -h "ALLOC CHECK" "$WORK/main.log" "$WORK/swarm.log"
+[ $status -eq 0 ] && echo "alloc_check: PASS"
+exit $status
@@ -3,15 +3,87 @@
 
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <iostream>
+#include <cstdio>
 #include <pthread.h>
 #include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <algorithm>
+#include <cctype>
 
 // ========== Safety Constants ==========
 const double MIN_SAFE_DISTANCE = 10.0;
 const double EMERGENCY_DECEL = 8.0;
-const int MAX_TRUCKS = 8;
+const unsigned short LEADER_SPEED = 10;   // leader cruise speed, m/tick
+
+// Build with -DPLATOON_MAX_TRUCKS=N to size the segment for large swarms;
+// the main frame and every truck must agree on it
+#ifndef PLATOON_MAX_TRUCKS
+#define PLATOON_MAX_TRUCKS 8
+#endif
+const int MAX_TRUCKS = PLATOON_MAX_TRUCKS;
+
+// Trucks start 100 m apart, closer in large builds so that every slot's
+// starting position fits the protocol's unsigned short
+const int START_SPACING = (MAX_TRUCKS + 1) * 100 <= 65535 ? 100 : 65535 / (MAX_TRUCKS + 1);
+
+inline unsigned short startPosition(int slot) {
+    return (unsigned short)((slot + 1) * START_SPACING);
+}
+
+// ========== Warm Restart ==========
+const uint32_t LAYOUT_MAGIC = 0x504C5431;    // "PLT1"
+const uint32_t LAYOUT_VERSION = 8;           // bump when SharedMemoryLayout or MainFrameCheckpoint changes
+const int CHECKPOINT_INTERVAL_TICKS = 5;
+const char* const CHECKPOINT_DIR = "/tmp";
+
+// ========== Leader Failover ==========
+const int HEARTBEAT_PERIOD_MS = 100;   // every truck refreshes its heartbeat this often
+const int LEADER_TIMEOUT_MS = 500;     // leader silent this long -> re-election
+
+// ========== Sharding ==========
+// Shard k serves road positions [k * shard_width, (k + 1) * shard_width); the
+// last shard also takes everything beyond. Shard 0's segment doubles as the
+// coordination segment (leader command, election, follower status).
+const char* const SEGMENT_NAME = "/main_frame_memory";
+const int MAX_SHARDS = 16;
+const int SHARD_UDP_BASE_PORT = 7100;          // shard k listens on 127.0.0.1:base+k
+const int SHARD_BOUNDARY_STALE_TICKS = 3;      // ignore a neighbor's boundary after this
+const int PRESENCE_TICKS = 2;                  // a truck counts as on the shard this long
+const unsigned short CLEAR_ROAD_DISTANCE = 100;
+
+// ========== Road Obstacles ==========
+// Obstacles live on the road, not on a truck: each shard keeps the ones in
+// its stretch sorted by (lane, position). The platoon drives in PLATOON_LANE.
+#ifndef PLATOON_MAX_OBSTACLES
+#define PLATOON_MAX_OBSTACLES 4096
+#endif
+const int MAX_OBSTACLES = PLATOON_MAX_OBSTACLES;
+const int MAX_LANES = 4;
+const uint8_t PLATOON_LANE = 0;
+const unsigned short NO_OBSTACLE = 0xFFFF;
+
+// ========== Sensor Fusion ==========
+// The main frame can corrupt the true gap with a noise/dropout model and then
+// smooth it with a per-truck Kalman filter before it reaches the follower.
+const double SENSOR_PROCESS_ACCEL = 0.5;    // m/tick^2 std dev of the closing rate change
+const double SENSOR_INIT_RATE_VAR = 25.0;   // initial closing-rate uncertainty
+const int SENSOR_BUDGET_US = 200;           // per-tick limit for the whole stage
+const int SENSOR_BUDGET_CHECK = 32;         // trucks between clock reads
+const int SENSOR_REPORT_TICKS = 10;         // print timing statistics this often
+
+// ========== Truck History ==========
+// The main frame keeps the last HISTORY_TICKS samples of every truck's gap
+// and speed, with the window's aggregates updated as each sample goes in.
+#ifndef PLATOON_HISTORY_TICKS
+#define PLATOON_HISTORY_TICKS 60
+#endif
+const int HISTORY_TICKS = PLATOON_HISTORY_TICKS;   // one sample per tick: the last minute
+// A history whose newest sample is older than this would have aged out entirely
+const uint64_t HISTORY_STALE_NS = (uint64_t)HISTORY_TICKS * 1000000000ULL;
 
 // ========== Message Structures (from main's perspective) ==========
 
@@ -26,7 +98,8 @@ struct rxMainMessageFrame {
 // Main_frame sends sensor data to truck
 struct txMainMessageFrame {
     unsigned short sensor_data;      // distance to front truck
-    bool obstacle_detected;
+    unsigned short obstacle_distance;  // nearest obstacle ahead in our lane, NO_OBSTACLE if none
+    bool obstacle_detected;          // that obstacle is within stopping distance
     bool response_ready;
 };
 
@@ -34,6 +107,7 @@ struct txMainMessageFrame {
 struct LeaderCommandFrame {
     unsigned short distance_setpoint;
     bool emergency_brake_all;
+    short leader_accel;              // leader's speed change over its last tick, m/tick
 };
 
 // Follower reports status to leader
@@ -43,10 +117,69 @@ struct FollowerReportFrame {
     bool is_active;
 };
 
+// Exchanged between shards every tick over local UDP
+struct ShardBoundaryMsg {
+    uint32_t magic;
+    int32_t shard;
+    uint8_t has_truck;
+    unsigned short rear_position;   // rearmost truck on the sender's shard
+    uint8_t has_obstacle;
+    unsigned short first_obstacle;  // rearmost platoon-lane obstacle on the sender's shard
+};
+
+struct RoadObstacle {
+    uint8_t lane;
+    unsigned short position;
+};
+
+// Sorted by (lane, position), no duplicates
+struct ObstacleIndex {
+    int count;
+    RoadObstacle entries[MAX_OBSTACLES];
+};
+
+// Circular history of one truck. Samples are numbered from 1 since the last
+// reset; sample n lives at ring index n % HISTORY_TICKS. The min/max queues
+// hold sample numbers with monotonic gaps, so the window's extremes are at
+// their fronts.
+struct TruckHistory {
+    uint32_t samples;
+    uint64_t last_sample_ns;     // CLOCK_MONOTONIC, 0 = no samples
+    unsigned short gap[HISTORY_TICKS];
+    unsigned short speed[HISTORY_TICKS];
+    uint32_t min_queue[HISTORY_TICKS];
+    uint32_t max_queue[HISTORY_TICKS];
+    uint32_t min_head, min_tail;     // queue counters, wrap with % HISTORY_TICKS
+    uint32_t max_head, max_tail;
+    uint64_t gap_sum;            // integer sums keep mean/variance exact
+    uint64_t gap_sq_sum;
+    uint64_t speed_sum;
+};
+
+// What a query returns for the current window
+struct TruckWindowStats {
+    uint32_t samples;            // in the window, up to HISTORY_TICKS
+    unsigned short min_gap;
+    unsigned short max_gap;
+    double mean_gap;
+    double gap_variance;
+    double mean_speed;
+};
+
 // ========== Shared Memory Layout ==========
 
 struct SharedMemoryLayout {
-    pthread_mutex_t global_mutex;
+    pthread_mutex_t global_mutex;   // robust: survives a holder dying
+    
+    // Identifies a segment a restarted main frame may reattach to
+    uint32_t magic;
+    uint32_t version;
+    pid_t main_frame_pid;
+    
+    // Which part of the road this segment serves
+    int shard_index;
+    int shard_count;             // 1 = unsharded
+    unsigned short shard_width;
     
     // Communication between trucks and main_frame
     rxMainMessageFrame rx_slots[MAX_TRUCKS];
@@ -56,11 +189,392 @@ struct SharedMemoryLayout {
     LeaderCommandFrame leader_cmd;
     FollowerReportFrame follower_status[MAX_TRUCKS];
     
+    // Obstacles on this shard's stretch of road
+    ObstacleIndex obstacles;
+    
+    // Recent gap/speed of every truck served here
+    TruckHistory history[MAX_TRUCKS];
+    
+    // Liveness and leader election (CLOCK_MONOTONIC, 0 = never seen)
+    uint64_t truck_heartbeat_ns[MAX_TRUCKS];
+    unsigned short truck_position[MAX_TRUCKS];   // posted with each heartbeat
+    int leader_slot;             // -1 when no leader has claimed the platoon
+    uint32_t leader_term;        // bumped on every takeover
+    uint32_t last_failover_ms;   // leader loss -> first command from new leader
+    
     // System state
     uint64_t tick;
     bool system_running;
 };
 
+// Main frame state written to disk so a cold start can resume the platoon.
+// Only what the main frame owns: slots belong to trucks, and after a cold
+// start no truck is attached to claim them.
+struct MainFrameCheckpoint {
+    uint32_t magic;
+    uint32_t version;
+    LeaderCommandFrame leader_cmd;
+    ObstacleIndex obstacles;
+    uint64_t tick;
+};
+
+// ========== Segment Naming and Attach ==========
+
+// Unsharded runs keep the original name; shard k appends _k
+inline void segmentName(char* buf, size_t len, int shard, int shard_count) {
+    if (shard_count <= 1) {
+        std::snprintf(buf, len, "%s", SEGMENT_NAME);
+    } else {
+        std::snprintf(buf, len, "%s_%d", SEGMENT_NAME, shard);
+    }
+}
+
+inline void checkpointPath(char* buf, size_t len, int shard, int shard_count, bool tmp) {
+    const char* suffix = tmp ? ".tmp" : "";
+    if (shard_count <= 1) {
+        std::snprintf(buf, len, "%s/main_frame_checkpoint.bin%s", CHECKPOINT_DIR, suffix);
+    } else {
+        std::snprintf(buf, len, "%s/main_frame_checkpoint_%d.bin%s", CHECKPOINT_DIR, shard, suffix);
+    }
+}
+
+inline int shardForPosition(unsigned short position, int shard_count, unsigned short shard_width) {
+    if (shard_count <= 1 || shard_width == 0) return 0;
+    int shard = position / shard_width;
+    return shard < shard_count ? shard : shard_count - 1;
+}
+
+// Map an existing segment, checking it was built with this layout.
+// Returns nullptr if it does not exist (*exists = false) or does not match.
+inline SharedMemoryLayout* attachSegment(const char* name, bool* exists) {
+    int file_descriptor = shm_open(name, O_RDWR, 0666);
+    *exists = file_descriptor != -1;
+    if (file_descriptor == -1) return nullptr;
+
+    // Guards against a main frame built with a different MAX_TRUCKS
+    struct stat st;
+    if (fstat(file_descriptor, &st) == -1 || st.st_size != (off_t)sizeof(SharedMemoryLayout)) {
+        close(file_descriptor);
+        return nullptr;
+    }
+
+    auto* shm = (SharedMemoryLayout*) mmap(
+        nullptr,
+        sizeof(SharedMemoryLayout),
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        file_descriptor,
+        0
+    );
+    close(file_descriptor);   // the mapping stays valid
+    if (shm == MAP_FAILED) return nullptr;
+
+    if (shm->magic != LAYOUT_MAGIC || shm->version != LAYOUT_VERSION) {
+        munmap(shm, sizeof(SharedMemoryLayout));
+        return nullptr;
+    }
+    return shm;
+}
+
+// ========== Shard Map ==========
+
+// Every segment a truck may talk to. Unsharded runs have one entry.
+// Shard 0 holds leader command, election and follower status for the whole
+// platoon; per-tick position/sensor traffic goes to the shard of the position.
+struct ShardMap {
+    int count;
+    unsigned short width;
+    SharedMemoryLayout* segments[MAX_SHARDS];
+
+    SharedMemoryLayout* coord() { return segments[0]; }
+    int shardOf(unsigned short position) const { return shardForPosition(position, count, width); }
+    SharedMemoryLayout* road(unsigned short position) { return segments[shardOf(position)]; }
+};
+
+// Attach to the unsharded segment, or to every shard listed by shard 0.
+// Prints the reason and returns false on failure.
+inline bool attachShards(ShardMap& shards) {
+    char name[64];
+    bool exists = false;
+    segmentName(name, sizeof(name), 0, 1);
+    shards.segments[0] = attachSegment(name, &exists);
+    if (!exists) {
+        segmentName(name, sizeof(name), 0, MAX_SHARDS);
+        shards.segments[0] = attachSegment(name, &exists);
+    }
+    if (!exists) {
+        std::cerr << "Cannot open shared memory. Is main_frame running?\n";
+        return false;
+    }
+    if (!shards.segments[0]) {
+        std::cerr << "Shared memory layout mismatch. Rebuild main_frame and this program\n";
+        return false;
+    }
+
+    shards.count = shards.segments[0]->shard_count;
+    shards.width = shards.segments[0]->shard_width;
+    for (int k = 1; k < shards.count; k++) {
+        segmentName(name, sizeof(name), k, shards.count);
+        shards.segments[k] = attachSegment(name, &exists);
+        if (!shards.segments[k]) {
+            std::cerr << "Cannot attach to shard " << k << ". Are all shards running?\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void detachShards(ShardMap& shards) {
+    for (int k = 0; k < shards.count; k++) {
+        munmap(shards.segments[k], sizeof(SharedMemoryLayout));
+    }
+}
+
+// ========== Shared Memory Locking ==========
+
+inline void lockShared(SharedMemoryLayout* shm) {
+    int rc = pthread_mutex_lock(&shm->global_mutex);
+    if (rc == EOWNERDEAD) {
+        // Previous holder died mid-update; slot fields are plain values, keep them
+        pthread_mutex_consistent(&shm->global_mutex);
+    }
+}
+
+inline void unlockShared(SharedMemoryLayout* shm) {
+    pthread_mutex_unlock(&shm->global_mutex);
+}
+
+// ========== Obstacle Index ==========
+//
+// A sorted array rather than a tree: it lives in shared memory, so no
+// pointers. Lookups are binary searches; inserts and removes shift the tail,
+// which is fine because obstacles change far less often than trucks query.
+// Callers hold the shared lock.
+
+inline bool obstacleLess(const RoadObstacle& a, const RoadObstacle& b) {
+    return a.lane != b.lane ? a.lane < b.lane : a.position < b.position;
+}
+
+// First entry not before (lane, position)
+inline const RoadObstacle* obstacleLowerBound(const ObstacleIndex& index, uint8_t lane,
+                                              unsigned short position) {
+    return std::lower_bound(index.entries, index.entries + index.count,
+                            RoadObstacle{lane, position}, obstacleLess);
+}
+
+// One lane's obstacles as [*begin, *end)
+inline void obstacleLane(const ObstacleIndex& index, uint8_t lane,
+                         const RoadObstacle** begin, const RoadObstacle** end) {
+    *begin = obstacleLowerBound(index, lane, 0);
+    *end = std::upper_bound(*begin, index.entries + index.count,
+                            RoadObstacle{lane, 0xFFFF}, obstacleLess);
+}
+
+// Returns false if the index is full; placing an existing obstacle is a no-op
+inline bool obstacleInsert(ObstacleIndex& index, uint8_t lane, unsigned short position) {
+    RoadObstacle* end = index.entries + index.count;
+    RoadObstacle* at = std::lower_bound(index.entries, end, RoadObstacle{lane, position}, obstacleLess);
+    if (at != end && at->lane == lane && at->position == position) return true;
+    if (index.count >= MAX_OBSTACLES) return false;
+
+    std::copy_backward(at, end, end + 1);
+    *at = RoadObstacle{lane, position};
+    index.count++;
+    return true;
+}
+
+inline bool obstacleRemove(ObstacleIndex& index, uint8_t lane, unsigned short position) {
+    RoadObstacle* end = index.entries + index.count;
+    RoadObstacle* at = std::lower_bound(index.entries, end, RoadObstacle{lane, position}, obstacleLess);
+    if (at == end || at->lane != lane || at->position != position) return false;
+
+    std::copy(at + 1, end, at);
+    index.count--;
+    return true;
+}
+
+// ========== Truck History Queries ==========
+//
+// Every operation is O(1) amortized per sample: each sample enters and
+// leaves each monotonic queue at most once. Callers hold the shared lock.
+
+inline void historyReset(TruckHistory& h) {
+    h.samples = 0;
+    h.last_sample_ns = 0;
+    h.min_head = h.min_tail = 0;
+    h.max_head = h.max_tail = 0;
+    h.gap_sum = h.gap_sq_sum = h.speed_sum = 0;
+}
+
+inline void historyPush(TruckHistory& h, unsigned short gap, unsigned short speed, uint64_t now_ns) {
+    uint32_t n = ++h.samples;
+
+    // Evict the sample leaving the window; it shares our ring index
+    if (n > (uint32_t)HISTORY_TICKS) {
+        uint32_t old = n - HISTORY_TICKS;
+        unsigned short old_gap = h.gap[old % HISTORY_TICKS];
+        h.gap_sum -= old_gap;
+        h.gap_sq_sum -= (uint64_t)old_gap * old_gap;
+        h.speed_sum -= h.speed[old % HISTORY_TICKS];
+        if (h.min_head != h.min_tail && h.min_queue[h.min_head % HISTORY_TICKS] == old) h.min_head++;
+        if (h.max_head != h.max_tail && h.max_queue[h.max_head % HISTORY_TICKS] == old) h.max_head++;
+    }
+
+    h.gap[n % HISTORY_TICKS] = gap;
+    h.speed[n % HISTORY_TICKS] = speed;
+    h.gap_sum += gap;
+    h.gap_sq_sum += (uint64_t)gap * gap;
+    h.speed_sum += speed;
+
+    // Drop samples the new one dominates; they can never be the extreme again
+    while (h.min_head != h.min_tail && h.gap[h.min_queue[(h.min_tail - 1) % HISTORY_TICKS] % HISTORY_TICKS] >= gap) {
+        h.min_tail--;
+    }
+    h.min_queue[h.min_tail++ % HISTORY_TICKS] = n;
+    while (h.max_head != h.max_tail && h.gap[h.max_queue[(h.max_tail - 1) % HISTORY_TICKS] % HISTORY_TICKS] <= gap) {
+        h.max_tail--;
+    }
+    h.max_queue[h.max_tail++ % HISTORY_TICKS] = n;
+
+    h.last_sample_ns = now_ns;
+}
+
+inline TruckWindowStats historyStats(const TruckHistory& h) {
+    TruckWindowStats stats{0, 0, 0, 0.0, 0.0, 0.0};
+    if (h.samples == 0) return stats;
+
+    uint32_t count = h.samples < (uint32_t)HISTORY_TICKS ? h.samples : HISTORY_TICKS;
+    stats.samples = count;
+    stats.min_gap = h.gap[h.min_queue[h.min_head % HISTORY_TICKS] % HISTORY_TICKS];
+    stats.max_gap = h.gap[h.max_queue[h.max_head % HISTORY_TICKS] % HISTORY_TICKS];
+    stats.mean_gap = (double)h.gap_sum / count;
+    stats.gap_variance = ((double)h.gap_sq_sum - (double)h.gap_sum * h.gap_sum / count) / count;
+    stats.mean_speed = (double)h.speed_sum / count;
+    return stats;
+}
+
+// ========== Console ==========
+
+// Non-blocking check for a typed command. Needs sync_with_stdio(false), or
+// libstdc++ never reports input as available. Leftover whitespace, such as
+// the newline after the previous command, is consumed first, so it cannot
+// look like input and leave `std::cin >> c` blocked mid-tick.
+inline bool commandPending() {
+    std::streambuf* in = std::cin.rdbuf();
+    while (in->in_avail() > 0 && std::isspace(in->sgetc())) in->sbumpc();
+    return in->in_avail() > 0;
+}
+
+// ========== Liveness ==========
+
+inline uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+inline bool isTruckAlive(const SharedMemoryLayout* shm, int slot, uint64_t now_ns) {
+    uint64_t last = shm->truck_heartbeat_ns[slot];
+    return last != 0 && now_ns - last < (uint64_t)LEADER_TIMEOUT_MS * 1000000ULL;
+}
+
+// Deterministic election: every truck picks the same winner, the live truck
+// furthest along the road by the position posted with its heartbeat (lowest
+// slot on a tie). Slot numbers say nothing about order on the road. Returns
+// -1 if none alive.
+inline int electLeader(const SharedMemoryLayout* shm, uint64_t now_ns) {
+    int best = -1;
+    for (int i = 0; i < MAX_TRUCKS; i++) {
+        if (!isTruckAlive(shm, i, now_ns)) continue;
+        if (best < 0 || shm->truck_position[i] > shm->truck_position[best]) best = i;
+    }
+    return best;
+}
+
+// ========== Allocation Check ==========
+//
+// Build with -DPLATOON_ALLOC_CHECK to count every operator new. Each loop
+// calls allocCheckTick() once per iteration and aborts if the count moves
+// after ALLOC_WARMUP_ITERATIONS. Every program here is a single translation
+// unit, so the global replacement can live in this header.
+//
+// The count is process-wide, and coroutine trucks run several loops in one
+// process. Code that legitimately allocates mid-run (a role change creates a
+// new coroutine frame) calls allocCheckRearm() first: every loop then
+// restarts its warm-up and takes a new baseline.
+//
+// With PLATOON_ALLOC_CHECK_ITERATIONS=N in the environment, the process
+// exits 0 once a loop has run N iterations since the last re-arm, so a
+// scripted run (alloc_check.sh) passes or fails by exit status.
+
+const int ALLOC_WARMUP_ITERATIONS = 3;
+
+struct AllocWatch {
+    const char* loop_name;
+    int iterations;
+    uint64_t baseline;
+    uint32_t epoch;
+};
+
+#ifdef PLATOON_ALLOC_CHECK
+#include <new>
+#include <cstdlib>
+
+inline uint64_t& allocCount() {
+    static uint64_t count = 0;
+    return count;
+}
+
+void* operator new(std::size_t size) {
+    allocCount()++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+inline uint32_t& allocEpoch() {
+    static uint32_t epoch = 0;
+    return epoch;
+}
+
+inline void allocCheckRearm() {
+    allocEpoch()++;
+}
+
+inline int allocCheckLimit() {
+    static int limit = [] {
+        const char* value = std::getenv("PLATOON_ALLOC_CHECK_ITERATIONS");
+        return value ? std::atoi(value) : 0;
+    }();
+    return limit;
+}
+
+inline void allocCheckTick(AllocWatch& watch) {
+    if (watch.epoch != allocEpoch()) {
+        watch.epoch = allocEpoch();
+        watch.iterations = 0;
+    }
+    watch.iterations++;
+    if (watch.iterations == ALLOC_WARMUP_ITERATIONS) {
+        watch.baseline = allocCount();
+    } else if (watch.iterations > ALLOC_WARMUP_ITERATIONS && allocCount() != watch.baseline) {
+        std::cerr << "ALLOC CHECK: " << watch.loop_name << " loop allocated "
+                  << (allocCount() - watch.baseline) << " time(s) after warm-up\n";
+        std::abort();
+    }
+    if (allocCheckLimit() > 0 && watch.iterations >= allocCheckLimit()) {
+        std::cerr << "ALLOC CHECK: " << watch.loop_name << " loop clean for "
+                  << watch.iterations << " iterations\n";
+        std::exit(0);
+    }
+}
+#else
+inline void allocCheckRearm() {}
+inline void allocCheckTick(AllocWatch&) {}
+#endif
+
 // ========== Simple Safety Functions ==========
 
 inline bool isSafeDistance(unsigned short distance) {
@@ -77,4 +591,121 @@ inline bool isCollisionRisk(unsigned short distance, unsigned short speed) {
     return distance < calculateStoppingDistance(speed);
 }
 
+// An obstacle does not move, so brake once it is inside stopping distance plus the safe gap
+inline bool isObstacleInPath(unsigned short obstacle_distance, unsigned short speed) {
+    return obstacle_distance < calculateStoppingDistance(speed) + MIN_SAFE_DISTANCE;
+}
+
+// ========== Follower Controllers ==========
+//
+// Controller laws are policies picked at compile time. A policy turns one
+// follower's gap error into an acceleration. stepFollowers() applies it to
+// every follower of a platoon at once over structure-of-arrays state, with
+// no branches in the loop so the compiler can vectorize it. Gains are
+// integer ratios so that T = int (the trucks' whole-metre fixed point)
+// stays exact, while T = float/double gives the continuous version.
+
+const int ACCEL_MAX = 2;
+const int ACCEL_MIN = -3;
+const int SPEED_MAX = 50;
+
+template <typename T, int KpNum, int KpDen>
+struct PControl {
+    static T accel(T gap, T /*prev_gap*/, T setpoint, T /*leader_accel*/) {
+        return (gap - setpoint) * KpNum / KpDen;
+    }
+};
+
+// Adds damping on the gap rate (relative speed to the truck ahead)
+template <typename T, int KpNum, int KpDen, int KdNum, int KdDen>
+struct PDControl {
+    static T accel(T gap, T prev_gap, T setpoint, T /*leader_accel*/) {
+        return (gap - setpoint) * KpNum / KpDen + (gap - prev_gap) * KdNum / KdDen;
+    }
+};
+
+// Cooperative ACC: PD plus the leader's acceleration fed forward
+template <typename T, int KpNum, int KpDen, int KdNum, int KdDen, int KffNum, int KffDen>
+struct CACCControl {
+    static T accel(T gap, T prev_gap, T setpoint, T leader_accel) {
+        return PDControl<T, KpNum, KpDen, KdNum, KdDen>::accel(gap, prev_gap, setpoint, leader_accel)
+             + leader_accel * KffNum / KffDen;
+    }
+};
+
+using FollowerP = PControl<int, 1, 5>;   // the original follower law: error / 5
+template <typename T> using FollowerPD = PDControl<T, 1, 5, 1, 2>;
+template <typename T> using FollowerCACC = CACCControl<T, 1, 5, 1, 2, 1, 1>;
+
+// Law used by the trucks and the safety sweep, e.g.
+// -D'PLATOON_FOLLOWER_POLICY=FollowerCACC<int>'
+#ifndef PLATOON_FOLLOWER_POLICY
+#define PLATOON_FOLLOWER_POLICY FollowerP
+#endif
+using TruckFollowerPolicy = PLATOON_FOLLOWER_POLICY;
+
+template <typename T>
+inline T clampValue(T v, T lo, T hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// One control step for one follower; returns the new speed
+template <typename Policy, typename T>
+inline T stepFollower(T speed, T gap, T prev_gap, T setpoint, T leader_accel) {
+    T accel = clampValue<T>(Policy::accel(gap, prev_gap, setpoint, leader_accel),
+                            (T)ACCEL_MIN, (T)ACCEL_MAX);
+    return clampValue<T>(speed + accel, (T)0, (T)SPEED_MAX);
+}
+
+// One control step for every follower of a platoon (SoA layout)
+template <typename Policy, typename T>
+inline void stepFollowers(int count, T* __restrict speed, const T* __restrict gap,
+                          T* __restrict prev_gap, T setpoint, T leader_accel) {
+    for (int i = 0; i < count; i++) {
+        speed[i] = stepFollower<Policy, T>(speed[i], gap[i], prev_gap[i], setpoint, leader_accel);
+        prev_gap[i] = gap[i];
+    }
+}
+
+// ========== Follower Control Step ==========
+//
+// One tick of a follower's safety + control logic, after leader emergency and
+// obstacle flags have been folded into emergency_mode. Shared by runFollower
+// and the safety sweep so both exercise exactly the same code. prev_distance
+// is the gap this follower measured on its previous step and leader_accel
+// comes from the leader's command frame; the P law ignores both.
+
+struct FollowerStepResult {
+    bool collision_risk;   // isCollisionRisk() put us into emergency this tick
+    bool stopped;          // emergency brake brought us to a stop, emergency cleared
+};
+
+inline FollowerStepResult followerControlStep(unsigned short& speed, bool& emergency_mode,
+                                              unsigned short distance, unsigned short prev_distance,
+                                              unsigned short desired_distance, int leader_accel) {
+    FollowerStepResult result{false, false};
+
+    // Safety check: collision risk?
+    if (!emergency_mode && isCollisionRisk(distance, speed)) {
+        emergency_mode = true;
+        result.collision_risk = true;
+    }
+
+    if (emergency_mode) {
+        // Emergency brake
+        if (speed > EMERGENCY_DECEL) {
+            speed -= EMERGENCY_DECEL;
+        } else {
+            speed = 0;
+            emergency_mode = false;  // Stopped safely
+            result.stopped = true;
+        }
+    } else {
+        // Normal distance control
+        speed = (unsigned short)stepFollower<TruckFollowerPolicy, int>(
+            speed, distance, prev_distance, desired_distance, leader_accel);
+    }
+    return result;
+}
+
 #endif
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <iomanip>
+#include <stdint.h>
+#include <vector>
+#include "common.h"
+
+// ========== Controller Benchmark ==========
+//
+// Times stepFollowers() for each controller policy over a large SoA
+// platoon. The gaps are moved by a simple kinematic update between steps,
+// so the controller always has fresh input.
+
+const int BENCH_FOLLOWERS = 4096;
+const int BENCH_STEPS = 20000;
+
+template <typename Policy, typename T>
+void benchPolicy(const char* label) {
+    std::vector<T> speed(BENCH_FOLLOWERS), gap(BENCH_FOLLOWERS), prev_gap(BENCH_FOLLOWERS);
+    for (int i = 0; i < BENCH_FOLLOWERS; i++) {
+        speed[i] = (T)(20 + i % 7);
+        gap[i] = (T)(15 + i % 11);
+        prev_gap[i] = gap[i];
+    }
+
+    const T setpoint = (T)20;
+    const T leader_speed = (T)22;
+    uint64_t control_ns = 0;
+
+    for (int step = 0; step < BENCH_STEPS; step++) {
+        T leader_accel = (T)((step % 8) < 4 ? 1 : -1);
+
+        uint64_t t0 = monotonicNs();
+        stepFollowers<Policy, T>(BENCH_FOLLOWERS, speed.data(), gap.data(), prev_gap.data(),
+                                 setpoint, leader_accel);
+        control_ns += monotonicNs() - t0;
+
+        // Kinematics: each gap closes by our speed and opens by the truck ahead's
+        gap[0] = clampValue<T>(gap[0] + leader_speed - speed[0], (T)0, (T)200);
+        for (int i = 1; i < BENCH_FOLLOWERS; i++) {
+            gap[i] = clampValue<T>(gap[i] + speed[i - 1] - speed[i], (T)0, (T)200);
+        }
+    }
+
+    double checksum = 0;
+    for (int i = 0; i < BENCH_FOLLOWERS; i++) checksum += speed[i];
+
+    double ns_per_truck = (double)control_ns / ((double)BENCH_STEPS * BENCH_FOLLOWERS);
+    std::cout << std::left << std::setw(18) << label << std::right
+              << std::fixed << std::setprecision(3)
+              << std::setw(12) << ns_per_truck
+              << std::setw(14) << std::setprecision(1) << 1e3 / ns_per_truck
+              << std::setw(14) << checksum << "\n";
+}
+
+int main() {
+    std::cout << BENCH_FOLLOWERS << " followers x " << BENCH_STEPS << " steps\n\n";
+    std::cout << std::left << std::setw(18) << "policy" << std::right
+              << std::setw(12) << "ns/truck" << std::setw(14) << "Mtruck/s"
+              << std::setw(14) << "checksum" << "\n";
+
+    benchPolicy<FollowerP, int>("P int");
+    benchPolicy<PControl<float, 1, 5>, float>("P float");
+    benchPolicy<PControl<double, 1, 10>, double>("P double (udp)");
+    benchPolicy<FollowerPD<int>, int>("PD int");
+    benchPolicy<FollowerPD<float>, float>("PD float");
+    benchPolicy<FollowerCACC<int>, int>("CACC int");
+    benchPolicy<FollowerCACC<float>, float>("CACC float");
+
+    return 0;
+}
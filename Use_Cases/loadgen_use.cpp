@@ -0,0 +1,385 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <pthread.h>
+#include <stdint.h>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "common.h"
+
+// ========== Load Generator ==========
+//
+// Attaches to the main frame like a set of trucks (to every shard, when it
+// is sharded) and ramps up the number of virtual trucks stage by stage. The
+// virtual trucks follow a motion profile, leave and rejoin the platoon, and
+// hit obstacles placed on the road ahead of them. A background field of obstacles across all lanes
+// can be scattered first to load the main frame's obstacle index.
+// Each stage reports the main frame's throughput, request->response latency
+// and missed ticks. Like a real truck, each virtual truck posts to the shard
+// that owns its position and reports status to shard 0; obstacles go to the
+// shard that owns their position. Segments are locked one at a time.
+
+const int POLL_PERIOD_MS = 5;
+const int REQUEST_PERIOD_MS = 1000;    // same rate as a real truck
+const int TICK_PERIOD_MS = 1000;       // main frame's sleep(1)
+const int OBSTACLE_HOLD_MS = 2000;
+const int OBSTACLE_AHEAD_MIN = 20;     // injected obstacle lands this far ahead...
+const int OBSTACLE_AHEAD_MAX = 80;     // ...up to this far
+
+enum class MotionProfile { Constant, Sine, StopGo };
+
+struct VirtualTruck {
+    int slot;
+    bool active;
+    bool waiting;             // request posted, response not yet seen
+    int shard;                // shard our slot is posted on
+    double position;
+    double speed;
+    uint64_t next_request_ns;
+    uint64_t sent_ns;
+    uint64_t obstacle_until_ns;
+    unsigned short obstacle_position;
+    unsigned short distance;  // last sensor value, reported on shard 0
+};
+
+struct StageStats {
+    uint64_t requests;
+    uint64_t responses;
+    uint64_t joins;
+    uint64_t leaves;
+    uint64_t obstacles;
+    std::vector<double> latency_ms;
+};
+
+double profileSpeed(MotionProfile profile, int slot, double t_s, std::mt19937& rng) {
+    switch (profile) {
+    case MotionProfile::Sine:
+        return 20.0 + 10.0 * std::sin(0.5 * t_s + slot);
+    case MotionProfile::StopGo: {
+        std::uniform_int_distribution<int> coin(0, 9);
+        return coin(rng) < 2 ? 0.0 : 25.0;
+    }
+    case MotionProfile::Constant:
+    default:
+        return 20.0;
+    }
+}
+
+double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = (size_t)(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+// The helpers below lock each segment they touch, one at a time
+
+void joinTruck(VirtualTruck& truck, ShardMap& shards, uint64_t now, std::mt19937& rng) {
+    // Stagger requests so the load is spread across the tick like real trucks
+    std::uniform_int_distribution<int> offset_ms(0, REQUEST_PERIOD_MS - 1);
+    truck.active = true;
+    truck.waiting = false;
+    truck.position = startPosition(truck.slot);
+    truck.shard = shards.shardOf((unsigned short)truck.position);
+    truck.speed = 0.0;
+    truck.next_request_ns = now + (uint64_t)offset_ms(rng) * 1000000ULL;
+    truck.obstacle_until_ns = 0;
+    truck.distance = 0;
+
+    SharedMemoryLayout* coord = shards.coord();
+    lockShared(coord);
+    coord->follower_status[truck.slot].is_active = true;
+    coord->follower_status[truck.slot].emergency_active = false;
+    unlockShared(coord);
+}
+
+// Places an obstacle only where none exists yet. True means we created it and
+// may remove it later; obstacles placed by the operator or another truck are
+// never ours to delete.
+bool placeOwnObstacle(ObstacleIndex& index, uint8_t lane, unsigned short position) {
+    const RoadObstacle* at = obstacleLowerBound(index, lane, position);
+    if (at != index.entries + index.count && at->lane == lane && at->position == position) return false;
+    return obstacleInsert(index, lane, position);
+}
+
+// Drop an obstacle just ahead of the truck, on whichever shard owns that spot
+void placeTruckObstacle(VirtualTruck& truck, ShardMap& shards, unsigned short at, uint64_t until_ns) {
+    SharedMemoryLayout* road = shards.road(at);
+    lockShared(road);
+    bool placed = placeOwnObstacle(road->obstacles, PLATOON_LANE, at);
+    unlockShared(road);
+    if (placed) {
+        truck.obstacle_position = at;
+        truck.obstacle_until_ns = until_ns;
+    }
+}
+
+void clearTruckObstacle(VirtualTruck& truck, ShardMap& shards) {
+    if (truck.obstacle_until_ns == 0) return;
+    SharedMemoryLayout* road = shards.road(truck.obstacle_position);
+    lockShared(road);
+    obstacleRemove(road->obstacles, PLATOON_LANE, truck.obstacle_position);
+    unlockShared(road);
+    truck.obstacle_until_ns = 0;
+}
+
+void leaveTruck(VirtualTruck& truck, ShardMap& shards) {
+    truck.active = false;
+    truck.waiting = false;
+    clearTruckObstacle(truck, shards);
+
+    SharedMemoryLayout* road = shards.segments[truck.shard];
+    lockShared(road);
+    road->rx_slots[truck.slot].request_ready = false;
+    unlockShared(road);
+
+    SharedMemoryLayout* coord = shards.coord();
+    lockShared(coord);
+    coord->follower_status[truck.slot].is_active = false;
+    unlockShared(coord);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <first slot> <max trucks> [step] [seconds/stage] [profile c/s/g] [churn %/s] [obstacle %/s] [seed]"
+                  << " [background obstacles]\n";
+        std::cerr << "Example: " << argv[0] << " 1 7 1 5 s 5 2 1 3000\n";
+        return 1;
+    }
+
+    int first_slot = std::atoi(argv[1]);
+    int max_trucks = std::atoi(argv[2]);
+    int step = argc > 3 ? std::atoi(argv[3]) : 1;
+    int stage_seconds = argc > 4 ? std::atoi(argv[4]) : 5;
+    char profile_arg = argc > 5 ? argv[5][0] : 'c';
+    double churn_pct = argc > 6 ? std::atof(argv[6]) : 0.0;
+    double obstacle_pct = argc > 7 ? std::atof(argv[7]) : 0.0;
+    unsigned seed = argc > 8 ? (unsigned)std::atoi(argv[8]) : 1;
+    int background_obstacles = argc > 9 ? std::atoi(argv[9]) : 0;
+
+    if (first_slot < 0 || max_trucks < 1 || first_slot + max_trucks > MAX_TRUCKS) {
+        std::cerr << "Slots must be within 0-" << (MAX_TRUCKS-1) << "\n";
+        return 1;
+    }
+    if (step < 1 || stage_seconds < 1) {
+        std::cerr << "Step and seconds/stage must be positive\n";
+        return 1;
+    }
+
+    MotionProfile profile = MotionProfile::Constant;
+    if (profile_arg == 's') profile = MotionProfile::Sine;
+    if (profile_arg == 'g') profile = MotionProfile::StopGo;
+
+    ShardMap shards{};
+    if (!attachShards(shards)) return 1;
+    SharedMemoryLayout* coord = shards.coord();
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> chance(0.0, 100.0);
+
+    std::vector<VirtualTruck> trucks(max_trucks);
+    for (int i = 0; i < max_trucks; i++) {
+        trucks[i] = VirtualTruck{first_slot + i, false, false, 0, 0.0, 0.0, 0, 0, 0, 0, 0};
+    }
+
+    // Background field, mostly in other lanes so the platoon can still drive
+    std::vector<RoadObstacle> background;
+    background.reserve(background_obstacles > 0 ? background_obstacles : 0);
+    std::uniform_int_distribution<int> any_position(0, 0xFFFF);
+    std::uniform_int_distribution<int> any_lane(1, MAX_LANES - 1);
+    for (int i = 0; i < background_obstacles; i++) {
+        RoadObstacle o{(uint8_t)any_lane(rng), (unsigned short)any_position(rng)};
+        SharedMemoryLayout* road = shards.road(o.position);
+        lockShared(road);
+        bool placed = road->obstacles.count < MAX_OBSTACLES && placeOwnObstacle(road->obstacles, o.lane, o.position);
+        unlockShared(road);
+        if (placed) background.push_back(o);
+    }
+    int indexed = 0;
+    for (int k = 0; k < shards.count; k++) {
+        lockShared(shards.segments[k]);
+        indexed += shards.segments[k]->obstacles.count;
+        unlockShared(shards.segments[k]);
+    }
+    if (background_obstacles > 0) {
+        std::cout << "Scattered " << background.size() << " background obstacles ("
+                  << indexed << " in index)\n";
+    }
+
+    std::cout << "Load generator: slots " << first_slot << "-" << (first_slot + max_trucks - 1)
+              << " on " << shards.count << " shard(s), +" << step << " trucks every " << stage_seconds << " s"
+              << ", churn " << churn_pct << "%/s, obstacles " << obstacle_pct << "%/s\n\n";
+    std::cout << std::setw(7) << "trucks" << std::setw(10) << "req/s" << std::setw(10) << "resp/s"
+              << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+              << std::setw(8) << "missed" << std::setw(7) << "joins" << std::setw(7) << "leaves"
+              << std::setw(6) << "obst" << "\n";
+
+    uint64_t start_ns = monotonicNs();
+    int target = 0;
+    bool running = true;
+
+    while (running && target < max_trucks) {
+        target = std::min(target + step, max_trucks);
+
+        StageStats stats{0, 0, 0, 0, 0, {}};
+        stats.latency_ms.reserve((size_t)target * stage_seconds * 2);
+
+        uint64_t stage_start = monotonicNs();
+        uint64_t stage_end = stage_start + (uint64_t)stage_seconds * 1000000000ULL;
+        uint64_t next_event_ns = stage_start;
+
+        lockShared(coord);
+        uint64_t tick_at_start = coord->tick;
+        unlockShared(coord);
+        for (int i = 0; i < target; i++) {
+            if (!trucks[i].active) {
+                joinTruck(trucks[i], shards, stage_start, rng);
+            }
+        }
+
+        uint64_t now = stage_start;
+        AllocWatch alloc_watch{"load generator", 0, 0, 0};
+        while (now < stage_end) {
+            allocCheckTick(alloc_watch);
+            bool churn_round = now >= next_event_ns;
+            if (churn_round) next_event_ns += 1000000000ULL;
+
+            // Shard 0: liveness and every truck's status
+            lockShared(coord);
+            if (!coord->system_running) {
+                unlockShared(coord);
+                std::cout << "Main frame shut down\n";
+                running = false;
+                break;
+            }
+            for (int i = 0; i < target; i++) {
+                if (trucks[i].active) coord->follower_status[trucks[i].slot].actual_distance = trucks[i].distance;
+            }
+            unlockShared(coord);
+
+            // Once per second: leave/rejoin churn and obstacle injection
+            for (int i = 0; i < target; i++) {
+                VirtualTruck& truck = trucks[i];
+                if (churn_round) {
+                    if (truck.active && chance(rng) < churn_pct) {
+                        leaveTruck(truck, shards);
+                        stats.leaves++;
+                        continue;
+                    }
+                    if (!truck.active && chance(rng) < 50.0) {
+                        joinTruck(truck, shards, now, rng);
+                        stats.joins++;
+                    }
+                    if (truck.active && truck.obstacle_until_ns == 0 && chance(rng) < obstacle_pct) {
+                        std::uniform_int_distribution<int> ahead(OBSTACLE_AHEAD_MIN, OBSTACLE_AHEAD_MAX);
+                        unsigned short at = (unsigned short)((int)truck.position + ahead(rng));
+                        placeTruckObstacle(truck, shards, at, now + (uint64_t)OBSTACLE_HOLD_MS * 1000000ULL);
+                        if (truck.obstacle_until_ns != 0) stats.obstacles++;
+                    }
+                }
+                if (truck.active && truck.obstacle_until_ns != 0 && now >= truck.obstacle_until_ns) {
+                    clearTruckObstacle(truck, shards);
+                }
+            }
+
+            // Each shard serves the trucks posted on it
+            for (int k = 0; k < shards.count; k++) {
+                SharedMemoryLayout* road = shards.segments[k];
+                lockShared(road);
+                for (int i = 0; i < target; i++) {
+                    VirtualTruck& truck = trucks[i];
+                    if (!truck.active || truck.shard != k) continue;
+                    int s = truck.slot;
+
+                    // Collect the main frame's answer
+                    if (truck.waiting && road->tx_slots[s].response_ready) {
+                        stats.latency_ms.push_back((now - truck.sent_ns) / 1e6);
+                        stats.responses++;
+                        truck.waiting = false;
+                        truck.distance = road->tx_slots[s].sensor_data;
+                    }
+
+                    // Post the next request; a still-pending one is simply refreshed
+                    if (now >= truck.next_request_ns) {
+                        double t_s = (now - start_ns) / 1e9;
+                        double speed = profileSpeed(profile, s, t_s, rng);
+                        // Wrap like the protocol's unsigned short position does
+                        double position = std::fmod(truck.position + speed * REQUEST_PERIOD_MS / 1000.0, 65536.0);
+
+                        // Crossed into another shard: leave this one, post there on the next pass
+                        int next = shards.shardOf((unsigned short)position);
+                        if (next != k) {
+                            road->rx_slots[s].request_ready = false;
+                            truck.waiting = false;
+                            truck.shard = next;
+                            continue;
+                        }
+
+                        truck.speed = speed;
+                        truck.position = position;
+                        road->rx_slots[s].position = (unsigned short)truck.position;
+                        road->rx_slots[s].speed = (unsigned short)truck.speed;
+                        road->rx_slots[s].emergency_brake = false;
+                        road->rx_slots[s].request_ready = true;
+                        road->tx_slots[s].response_ready = false;
+
+                        if (!truck.waiting) {
+                            truck.sent_ns = now;
+                            truck.waiting = true;
+                        }
+                        truck.next_request_ns += (uint64_t)REQUEST_PERIOD_MS * 1000000ULL;
+                        stats.requests++;
+                    }
+                }
+                unlockShared(road);
+            }
+
+            usleep(POLL_PERIOD_MS * 1000);
+            now = monotonicNs();
+        }
+
+        lockShared(coord);
+        uint64_t ticks_seen = coord->tick - tick_at_start;
+        unlockShared(coord);
+
+        double elapsed_s = (now - stage_start) / 1e9;
+        long expected_ticks = (long)(elapsed_s * 1000 / TICK_PERIOD_MS);
+        long missed = expected_ticks - (long)ticks_seen;
+        if (missed < 0) missed = 0;
+
+        std::sort(stats.latency_ms.begin(), stats.latency_ms.end());
+        double max_ms = stats.latency_ms.empty() ? 0.0 : stats.latency_ms.back();
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(7) << target
+                  << std::setw(10) << stats.requests / elapsed_s
+                  << std::setw(10) << stats.responses / elapsed_s
+                  << std::setw(10) << percentile(stats.latency_ms, 0.50)
+                  << std::setw(10) << percentile(stats.latency_ms, 0.99)
+                  << std::setw(10) << max_ms
+                  << std::setw(8) << missed
+                  << std::setw(7) << stats.joins
+                  << std::setw(7) << stats.leaves
+                  << std::setw(6) << stats.obstacles << "\n";
+    }
+
+    // Cleanup: release every slot and obstacle we own
+    for (auto& truck : trucks) {
+        if (truck.active) leaveTruck(truck, shards);
+    }
+    for (const RoadObstacle& o : background) {
+        SharedMemoryLayout* road = shards.road(o.position);
+        lockShared(road);
+        obstacleRemove(road->obstacles, o.lane, o.position);
+        unlockShared(road);
+    }
+
+    detachShards(shards);
+
+    return 0;
+}
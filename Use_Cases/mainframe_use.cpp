@@ -1,22 +1,451 @@
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <cstdio>
 #include <iostream>
 #include <pthread.h>
 #include <stdint.h>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include "common.h"
 
-int main() {
-    const char* name = "/main_frame_memory";
+// ========== Checkpointing ==========
 
-    // Create shared memory
+// Caller holds the lock
+void takeCheckpoint(const SharedMemoryLayout* shm, MainFrameCheckpoint* cp) {
+    cp->magic = LAYOUT_MAGIC;
+    cp->version = LAYOUT_VERSION;
+    cp->leader_cmd = shm->leader_cmd;
+    cp->obstacles = shm->obstacles;
+    cp->tick = shm->tick;
+}
+
+// Write to a temp file and rename so a crash never leaves a torn checkpoint.
+// Plain POSIX I/O: no stdio buffer is allocated on the tick path.
+bool saveCheckpoint(const MainFrameCheckpoint& cp, const char* path, const char* tmp_path) {
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return false;
+
+    bool ok = write(fd, &cp, sizeof(cp)) == (ssize_t)sizeof(cp);
+    ok = (close(fd) == 0) && ok;
+    if (!ok) return false;
+
+    return rename(tmp_path, path) == 0;
+}
+
+bool loadCheckpoint(MainFrameCheckpoint* cp, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return false;
+
+    bool ok = read(fd, cp, sizeof(*cp)) == (ssize_t)sizeof(*cp);
+    close(fd);
+
+    return ok && cp->magic == LAYOUT_MAGIC && cp->version == LAYOUT_VERSION;
+}
+
+// Slots stay as initFreshLayout left them: cleared, waiting for trucks
+void restoreCheckpoint(SharedMemoryLayout* shm, const MainFrameCheckpoint& cp) {
+    shm->leader_cmd = cp.leader_cmd;
+    shm->obstacles = cp.obstacles;
+    shm->tick = cp.tick;
+}
+
+// ========== Segment Setup ==========
+
+void initFreshLayout(SharedMemoryLayout* shm, int shard_index, int shard_count,
+                     unsigned short shard_width, const char* checkpoint_path) {
+    // Robust mutex: if a truck or the main frame dies holding it,
+    // the next locker gets EOWNERDEAD instead of deadlocking
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&shm->global_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    // Initialize slots
+    for (int i = 0; i < MAX_TRUCKS; i++) {
+        shm->rx_slots[i] = rxMainMessageFrame{0, 0, false, false};
+        shm->tx_slots[i].sensor_data = 0;
+        shm->tx_slots[i].response_ready = false;
+        shm->tx_slots[i].obstacle_distance = NO_OBSTACLE;
+        shm->tx_slots[i].obstacle_detected = false;
+        shm->follower_status[i] = FollowerReportFrame{0, false, false};
+        shm->truck_heartbeat_ns[i] = 0;
+        shm->truck_position[i] = 0;
+        historyReset(shm->history[i]);
+    }
+
+    shm->obstacles.count = 0;
+    shm->leader_slot = -1;
+    shm->leader_term = 0;
+    shm->last_failover_ms = 0;
+    shm->tick = 0;
+    shm->leader_cmd.distance_setpoint = 20;
+    shm->leader_cmd.emergency_brake_all = false;
+    shm->shard_index = shard_index;
+    shm->shard_count = shard_count;
+    shm->shard_width = shard_width;
+
+    MainFrameCheckpoint cp;
+    if (loadCheckpoint(&cp, checkpoint_path)) {
+        restoreCheckpoint(shm, cp);
+        std::cout << "Restored checkpoint at tick " << shm->tick << "\n";
+    }
+
+    shm->version = LAYOUT_VERSION;
+    shm->magic = LAYOUT_MAGIC;   // written last: trucks check it on attach
+}
+
+// ========== Shard Boundaries ==========
+
+// Latest rearmost truck and obstacle reported by each other shard
+struct ShardBoundary {
+    bool has_truck;
+    unsigned short rear_position;
+    bool has_obstacle;
+    unsigned short first_obstacle;
+    uint64_t received_tick;    // our tick when it arrived, 0 = never
+};
+
+int openBoundarySocket(int shard_index) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1) return -1;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SHARD_UDP_BASE_PORT + shard_index);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void drainBoundaries(int fd, ShardBoundary* boundaries, int shard_count, uint64_t tick) {
+    ShardBoundaryMsg msg;
+    while (recvfrom(fd, &msg, sizeof(msg), MSG_DONTWAIT, nullptr, nullptr) == (ssize_t)sizeof(msg)) {
+        if (msg.magic != LAYOUT_MAGIC || msg.shard < 0 || msg.shard >= shard_count) continue;
+        boundaries[msg.shard].has_truck = msg.has_truck != 0;
+        boundaries[msg.shard].rear_position = msg.rear_position;
+        boundaries[msg.shard].has_obstacle = msg.has_obstacle != 0;
+        boundaries[msg.shard].first_obstacle = msg.first_obstacle;
+        boundaries[msg.shard].received_tick = tick + 1;
+    }
+}
+
+void sendBoundary(int fd, int shard_index, int shard_count, bool has_truck, unsigned short rear_position,
+                  bool has_obstacle, unsigned short first_obstacle) {
+    ShardBoundaryMsg msg{LAYOUT_MAGIC, shard_index, (uint8_t)has_truck, rear_position,
+                         (uint8_t)has_obstacle, first_obstacle};
+    for (int s = 0; s < shard_count; s++) {
+        if (s == shard_index) continue;
+        sockaddr_in to{};
+        to.sin_family = AF_INET;
+        to.sin_port = htons(SHARD_UDP_BASE_PORT + s);
+        to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sendto(fd, &msg, sizeof(msg), MSG_DONTWAIT, (sockaddr*)&to, sizeof(to));
+    }
+}
+
+// Rear of the nearest non-empty shard ahead of us, if any has reported recently
+bool frontBoundary(const ShardBoundary* boundaries, int shard_index, int shard_count,
+                   uint64_t tick, unsigned short* position) {
+    for (int s = shard_index + 1; s < shard_count; s++) {
+        const ShardBoundary& b = boundaries[s];
+        if (b.received_tick == 0 || b.received_tick + SHARD_BOUNDARY_STALE_TICKS < tick + 1) continue;
+        if (b.has_truck) {
+            *position = b.rear_position;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Rearmost platoon-lane obstacle on the nearest shard ahead that has one
+bool frontObstacle(const ShardBoundary* boundaries, int shard_index, int shard_count,
+                   uint64_t tick, unsigned short* position) {
+    for (int s = shard_index + 1; s < shard_count; s++) {
+        const ShardBoundary& b = boundaries[s];
+        if (b.received_tick == 0 || b.received_tick + SHARD_BOUNDARY_STALE_TICKS < tick + 1) continue;
+        if (b.has_obstacle) {
+            *position = b.first_obstacle;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ========== Sensor Fusion ==========
+//
+// One batched pass per tick: every truck that asked for data this tick gets
+// its true gap passed through the noise/dropout model and then a
+// constant-velocity Kalman filter on (gap, closing rate). Filter state is
+// kept per slot in structure-of-arrays form. A track restarts when the
+// truck ahead changes. The stage has a hard per-tick budget: trucks it
+// cannot reach in time get the raw measurement, and their track restarts.
+// Enabled with the 'n' command or at startup with PLATOON_SENSOR_NOISE (m)
+// and PLATOON_SENSOR_DROPOUT (%) in the environment.
+
+struct SensorConfig {
+    bool enabled;
+    double noise_m;          // measurement noise std dev
+    double dropout_pct;      // chance a measurement is lost
+};
+
+struct SensorStats {
+    uint64_t ticks;
+    uint64_t trucks;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t overruns;       // ticks that hit the budget
+    uint64_t skipped;        // trucks left unfiltered because of it
+    uint64_t dropouts;
+    double raw_sq_err;       // against the true gap, for RMS
+    double filtered_sq_err;
+    uint64_t measured;
+};
+
+const int FRONT_NONE = -1;          // clear road, nothing to track
+const int FRONT_BOUNDARY = MAX_TRUCKS;   // rear truck of a shard ahead
+
+struct SensorBatch {
+    int count;
+    int slot[MAX_TRUCKS];
+    int front[MAX_TRUCKS];
+    unsigned short truth[MAX_TRUCKS];
+};
+
+// Filter state per slot
+static bool kf_valid[MAX_TRUCKS];
+static int kf_front[MAX_TRUCKS];
+static uint64_t kf_tick[MAX_TRUCKS];    // tick of the last step, trucks may skip a tick
+static double kf_gap[MAX_TRUCKS];
+static double kf_rate[MAX_TRUCKS];
+static double kf_p00[MAX_TRUCKS];
+static double kf_p01[MAX_TRUCKS];
+static double kf_p11[MAX_TRUCKS];
+
+inline unsigned short toSensorValue(double metres) {
+    if (metres <= 0.0) return 0;
+    if (metres >= 65535.0) return 65535;
+    return (unsigned short)std::lround(metres);
+}
+
+// Returns the value the truck receives
+inline double kalmanStep(int i, int front, uint64_t tick, bool have_measurement, double z, double r) {
+    if (!kf_valid[i] || kf_front[i] != front || tick <= kf_tick[i]) {
+        // Dropouts only hit established tracks: the first reading always arrives
+        kf_valid[i] = true;
+        kf_front[i] = front;
+        kf_tick[i] = tick;
+        kf_gap[i] = z;
+        kf_rate[i] = 0.0;
+        kf_p00[i] = r;
+        kf_p01[i] = 0.0;
+        kf_p11[i] = SENSOR_INIT_RATE_VAR;
+        return z;
+    }
+
+    // Predict up to this tick, white-acceleration process noise
+    double dt = (double)(tick - kf_tick[i]);
+    double q = SENSOR_PROCESS_ACCEL * SENSOR_PROCESS_ACCEL;
+    kf_tick[i] = tick;
+    kf_gap[i] += kf_rate[i] * dt;
+    kf_p00[i] += dt * (2.0 * kf_p01[i] + dt * kf_p11[i]) + q * dt * dt * dt * dt / 4.0;
+    kf_p01[i] += dt * kf_p11[i] + q * dt * dt * dt / 2.0;
+    kf_p11[i] += q * dt * dt;
+
+    if (have_measurement) {
+        double s = kf_p00[i] + r;
+        double k0 = kf_p00[i] / s;
+        double k1 = kf_p01[i] / s;
+        double y = z - kf_gap[i];
+        kf_gap[i] += k0 * y;
+        kf_rate[i] += k1 * y;
+        kf_p11[i] -= k1 * kf_p01[i];
+        kf_p01[i] -= k0 * kf_p01[i];
+        kf_p00[i] -= k0 * kf_p00[i];
+    }
+    return kf_gap[i];
+}
+
+// Caller holds the lock; writes sensor_data for every truck in the batch
+void runSensorStage(SharedMemoryLayout* shm, const SensorBatch& batch, const SensorConfig& config,
+                    std::mt19937& rng, int* rotor, SensorStats& stats) {
+    uint64_t start = monotonicNs();
+    uint64_t budget_ns = (uint64_t)SENSOR_BUDGET_US * 1000ULL;
+    std::normal_distribution<double> noise(0.0, config.noise_m > 0.0 ? config.noise_m : 1.0);
+    std::uniform_real_distribution<double> chance(0.0, 100.0);
+    uint64_t tick = shm->tick;
+    double r = config.noise_m > 0.05 ? config.noise_m * config.noise_m : 0.0025;
+    bool over_budget = false;
+    int resume = -1;   // batch index of the first truck the budget cut off
+
+    // Start where the last overrun cut off, so it never starves the same trucks
+    int n = batch.count;
+    int first = n ? *rotor % n : 0;
+
+    for (int done = 0; done < n; done++) {
+        int j = (first + done) % n;
+        int i = batch.slot[j];
+        double truth = batch.truth[j];
+
+        if (batch.front[j] == FRONT_NONE) {
+            // Clear road: nothing to measure
+            kf_valid[i] = false;
+            shm->tx_slots[i].sensor_data = batch.truth[j];
+            continue;
+        }
+
+        if (!over_budget && done % SENSOR_BUDGET_CHECK == 0 && done > 0) {
+            over_budget = monotonicNs() - start > budget_ns;
+        }
+
+        double z = truth + (config.noise_m > 0.0 ? noise(rng) : 0.0);
+        bool dropped = config.dropout_pct > 0.0 && chance(rng) < config.dropout_pct;
+        double out;
+
+        if (over_budget) {
+            if (resume < 0) resume = j;
+            kf_valid[i] = false;
+            out = z;
+            stats.skipped++;
+        } else {
+            out = kalmanStep(i, batch.front[j], tick, !dropped, z, r);
+            if (dropped) stats.dropouts++;
+        }
+
+        shm->tx_slots[i].sensor_data = toSensorValue(out);
+        stats.raw_sq_err += (z - truth) * (z - truth);
+        stats.filtered_sq_err += (out - truth) * (out - truth);
+        stats.measured++;
+    }
+
+    if (resume >= 0) *rotor = resume;
+
+    uint64_t elapsed = monotonicNs() - start;
+    stats.ticks++;
+    stats.trucks += n;
+    stats.total_ns += elapsed;
+    if (elapsed > stats.max_ns) stats.max_ns = elapsed;
+    if (over_budget || elapsed > budget_ns) stats.overruns++;
+}
+
+// Shared by the 'n' command and the startup environment; returns false on bad values
+bool configureSensor(SensorConfig& config, SensorStats& stats, double noise_m, double dropout_pct) {
+    if (noise_m < 0.0 || dropout_pct < 0.0 || dropout_pct > 100.0) {
+        std::cout << "Need noise >= 0 m and dropout 0-100 %\n";
+        return false;
+    }
+    config.noise_m = noise_m;
+    config.dropout_pct = dropout_pct;
+    config.enabled = noise_m > 0.0 || dropout_pct > 0.0;
+    for (int i = 0; i < MAX_TRUCKS; i++) kf_valid[i] = false;
+    stats = SensorStats{};
+    if (config.enabled) {
+        std::cout << "Sensor noise " << noise_m << " m, dropout " << dropout_pct
+                  << " %, Kalman filter on\n";
+    } else {
+        std::cout << "Perfect sensor, filter off\n";
+    }
+    return true;
+}
+
+void reportSensorStats(SensorStats& stats) {
+    if (stats.ticks == 0) return;
+    double raw_rms = stats.measured ? std::sqrt(stats.raw_sq_err / stats.measured) : 0.0;
+    double filtered_rms = stats.measured ? std::sqrt(stats.filtered_sq_err / stats.measured) : 0.0;
+    std::cout << "Sensor stage: " << stats.trucks / stats.ticks << " trucks/tick, mean "
+              << stats.total_ns / stats.ticks / 1000.0 << " us, max " << stats.max_ns / 1000.0
+              << " us (budget " << SENSOR_BUDGET_US << "), overruns " << stats.overruns
+              << ", skipped " << stats.skipped << ", dropouts " << stats.dropouts
+              << ", RMS error raw " << raw_rms << " m / filtered " << filtered_rms << " m\n";
+    stats = SensorStats{};
+}
+
+// ========== History Display ==========
+
+// Caller holds the lock; rear to front like the platoon order
+void printHistory(const SharedMemoryLayout* shm, const int* order, int present) {
+    std::cout << "Last " << HISTORY_TICKS << " ticks:\n";
+    for (int k = 0; k < present; k++) {
+        int i = order[k];
+        TruckWindowStats stats = historyStats(shm->history[i]);
+        if (stats.samples == 0) continue;
+        std::cout << "  Truck " << i << ": gap min " << stats.min_gap << " / mean " << stats.mean_gap
+                  << " / max " << stats.max_gap << " m, gap std dev " << std::sqrt(stats.gap_variance)
+                  << " m, mean speed " << stats.mean_speed << " (" << stats.samples << " samples)\n";
+    }
+}
+
+// Per-tick scratch, sized once; static so large MAX_TRUCKS builds stay off the stack
+static uint64_t seen_tick[MAX_TRUCKS];   // tick + 1 a slot last posted here, 0 = never
+static int platoon_order[MAX_TRUCKS];    // present slots, rear to front
+static bool in_platoon[MAX_TRUCKS];
+static SensorBatch sensor_batch;
+
+int main(int argc, char* argv[]) {
+    // commandPending() relies on in_avail(), which libstdc++ only answers
+    // for unsynced streams; cout is flushed once per tick instead
+    std::ios::sync_with_stdio(false);
+    
+    int shard_index = 0;
+    int shard_count = 1;
+    unsigned short shard_width = 0;
+
+    if (argc == 4) {
+        shard_index = std::atoi(argv[1]);
+        shard_count = std::atoi(argv[2]);
+        shard_width = (unsigned short)std::atoi(argv[3]);
+    } else if (argc != 1) {
+        std::cerr << "Usage: " << argv[0] << " [<shard> <shard count> <shard width m>]\n";
+        std::cerr << "Example: " << argv[0] << " 1 4 500  (second of four shards, 500 m each)\n";
+        return 1;
+    }
+    if (shard_count < 1 || shard_count > MAX_SHARDS || shard_index < 0 || shard_index >= shard_count ||
+        (shard_count > 1 && shard_width == 0)) {
+        std::cerr << "Need 0 <= shard < shard count <= " << MAX_SHARDS << " and a positive width\n";
+        return 1;
+    }
+
+    char name[64];
+    char checkpoint_path[128];
+    char checkpoint_tmp_path[128];
+    segmentName(name, sizeof(name), shard_index, shard_count);
+    checkpointPath(checkpoint_path, sizeof(checkpoint_path), shard_index, shard_count, false);
+    checkpointPath(checkpoint_tmp_path, sizeof(checkpoint_tmp_path), shard_index, shard_count, true);
+    bool warm_restart = false;
+
+    // Create shared memory, or reattach to one left by a crashed main frame
     int file_descriptor = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (file_descriptor == -1 && errno == EEXIST) {
+        file_descriptor = shm_open(name, O_RDWR, 0666);
+        warm_restart = true;
+    }
     if (file_descriptor == -1) {
-        std::cerr << "Failed to create shared memory. Maybe already running?\n";
+        std::cerr << "Failed to open shared memory\n";
         return 1;
     }
 
-    ftruncate(file_descriptor, sizeof(SharedMemoryLayout));
+    if (warm_restart) {
+        struct stat st;
+        if (fstat(file_descriptor, &st) == -1 || st.st_size != (off_t)sizeof(SharedMemoryLayout)) {
+            std::cerr << "Existing shared memory has the wrong size. Remove /dev/shm" << name << "\n";
+            close(file_descriptor);
+            return 1;
+        }
+    } else {
+        ftruncate(file_descriptor, sizeof(SharedMemoryLayout));
+    }
 
     auto* data_to_main = (SharedMemoryLayout*) mmap(
         nullptr,
@@ -27,114 +456,331 @@ int main() {
         0
     );
 
-    // Initialize process-shared mutex
-    pthread_mutexattr_t attr;
-    pthread_mutexattr_init(&attr);
-    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&data_to_main->global_mutex, &attr);
+    if (data_to_main == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory\n";
+        close(file_descriptor);
+        return 1;
+    }
 
-    // Initialize slots
-    for (int i = 0; i < MAX_TRUCKS; i++) {
-        data_to_main->rx_slots[i].request_ready = false;
-        data_to_main->tx_slots[i].response_ready = false;
-        data_to_main->tx_slots[i].obstacle_detected = false;
-        data_to_main->follower_status[i].is_active = false;
+    if (warm_restart) {
+        if (data_to_main->magic != LAYOUT_MAGIC || data_to_main->version != LAYOUT_VERSION) {
+            std::cerr << "Existing shared memory has an incompatible layout. Remove /dev/shm" << name << "\n";
+            munmap(data_to_main, sizeof(SharedMemoryLayout));
+            close(file_descriptor);
+            return 1;
+        }
+
+        if (data_to_main->shard_count != shard_count || data_to_main->shard_width != shard_width) {
+            std::cerr << "Existing segment was created with a different shard layout\n";
+            munmap(data_to_main, sizeof(SharedMemoryLayout));
+            close(file_descriptor);
+            return 1;
+        }
+
+        pid_t old_pid = data_to_main->main_frame_pid;
+        if (old_pid > 0 && old_pid != getpid() && kill(old_pid, 0) == 0) {
+            std::cerr << "Main frame already running (pid " << old_pid << ")\n";
+            munmap(data_to_main, sizeof(SharedMemoryLayout));
+            close(file_descriptor);
+            return 1;
+        }
+
+        std::cout << "Reattached to live segment at tick " << data_to_main->tick << "\n";
+    } else {
+        initFreshLayout(data_to_main, shard_index, shard_count, shard_width, checkpoint_path);
     }
 
-    data_to_main->tick = 0;
+    lockShared(data_to_main);
+    data_to_main->main_frame_pid = getpid();
     data_to_main->system_running = true;
-    data_to_main->leader_cmd.distance_setpoint = 20;
-    data_to_main->leader_cmd.emergency_brake_all = false;
+    // After a warm reattach every present truck looks new for one presence
+    // window; their histories carry over instead of restarting
+    uint64_t adopt_until_tick = warm_restart ? data_to_main->tick + PRESENCE_TICKS : 0;
+    unlockShared(data_to_main);
+
+    int boundary_fd = -1;
+    ShardBoundary boundaries[MAX_SHARDS] = {};
+    if (shard_count > 1) {
+        boundary_fd = openBoundarySocket(shard_index);
+        if (boundary_fd == -1) {
+            std::cerr << "Failed to bind shard boundary port " << (SHARD_UDP_BASE_PORT + shard_index) << "\n";
+            munmap(data_to_main, sizeof(SharedMemoryLayout));
+            close(file_descriptor);
+            return 1;
+        }
+        std::cout << "Shard " << shard_index << "/" << shard_count << " serving positions "
+                  << shard_index * shard_width << "-";
+        if (shard_index == shard_count - 1) std::cout << "end\n";
+        else std::cout << (shard_index + 1) * shard_width - 1 << "\n";
+    }
 
     std::cout << "Main frame running\n";
     std::cout << "Commands:\n";
-    std::cout << "  o <slot>  - Place obstacle at truck slot\n";
+    std::cout << "  o <pos>   - Place obstacle on the road at position (platoon lane)\n";
+    std::cout << "  x <pos>   - Remove obstacle at position\n";
     std::cout << "  c         - Clear all obstacles\n";
+    std::cout << "  n <m> <%> - Sensor noise std dev and dropout rate, 0 0 = perfect sensor\n";
+    std::cout << "  h         - Gap/speed statistics over the last " << HISTORY_TICKS << " ticks\n";
+    std::cout << "  d         - Detach (trucks keep running, restart to reattach)\n";
     std::cout << "  q         - Quit\n\n";
 
+    bool detach = false;
+    int present = 0;
+    MainFrameCheckpoint checkpoint;
+    AllocWatch alloc_watch{"main frame", 0, 0, 0};
+    SensorConfig sensor_config{false, 0.0, 0.0};
+    SensorStats sensor_stats{};
+    std::mt19937 sensor_rng(1);
+    int sensor_rotor = 0;
+    const char* env_noise = std::getenv("PLATOON_SENSOR_NOISE");
+    const char* env_dropout = std::getenv("PLATOON_SENSOR_DROPOUT");
+    if (env_noise || env_dropout) {
+        configureSensor(sensor_config, sensor_stats, env_noise ? std::atof(env_noise) : 0.0,
+                        env_dropout ? std::atof(env_dropout) : 0.0);
+    }
+
     while (true) {
+        allocCheckTick(alloc_watch);
+
         // Handle user commands
-        if (std::cin.rdbuf()->in_avail()) {
+        if (commandPending()) {
             char cmd;
             std::cin >> cmd;
             
             if (cmd == 'q') {
-                pthread_mutex_lock(&data_to_main->global_mutex);
+                lockShared(data_to_main);
                 data_to_main->system_running = false;
-                pthread_mutex_unlock(&data_to_main->global_mutex);
+                unlockShared(data_to_main);
                 std::cout << "Shutting down...\n";
                 break;
             }
-            else if (cmd == 'o') {
-                int slot;
-                std::cin >> slot;
-                if (slot >= 0 && slot < MAX_TRUCKS) {
-                    pthread_mutex_lock(&data_to_main->global_mutex);
-                    data_to_main->tx_slots[slot].obstacle_detected = true;
-                    pthread_mutex_unlock(&data_to_main->global_mutex);
-                    std::cout << "Obstacle placed at slot " << slot << "\n";
+            else if (cmd == 'd') {
+                detach = true;
+                std::cout << "Detaching, segment left in place\n";
+                break;
+            }
+            else if (cmd == 'o' || cmd == 'x') {
+                int position;
+                std::cin >> position;
+                if (position < 0 || position > 0xFFFF ||
+                    shardForPosition((unsigned short)position, shard_count, shard_width) != shard_index) {
+                    std::cout << "Position " << position << " is not on this shard\n";
+                } else if (cmd == 'o') {
+                    lockShared(data_to_main);
+                    bool placed = obstacleInsert(data_to_main->obstacles, PLATOON_LANE, (unsigned short)position);
+                    unlockShared(data_to_main);
+                    if (placed) std::cout << "Obstacle placed at position " << position << "\n";
+                    else std::cout << "Obstacle index full (" << MAX_OBSTACLES << ")\n";
+                } else {
+                    lockShared(data_to_main);
+                    bool removed = obstacleRemove(data_to_main->obstacles, PLATOON_LANE, (unsigned short)position);
+                    unlockShared(data_to_main);
+                    std::cout << (removed ? "Obstacle removed at position " : "No obstacle at position ")
+                              << position << "\n";
                 }
             }
+            else if (cmd == 'n') {
+                double noise_m, dropout_pct;
+                std::cin >> noise_m >> dropout_pct;
+                configureSensor(sensor_config, sensor_stats, noise_m, dropout_pct);
+            }
+            else if (cmd == 'h') {
+                lockShared(data_to_main);
+                printHistory(data_to_main, platoon_order, present);
+                unlockShared(data_to_main);
+            }
             else if (cmd == 'c') {
-                pthread_mutex_lock(&data_to_main->global_mutex);
-                for (int i = 0; i < MAX_TRUCKS; i++) {
-                    data_to_main->tx_slots[i].obstacle_detected = false;
-                }
-                pthread_mutex_unlock(&data_to_main->global_mutex);
+                lockShared(data_to_main);
+                data_to_main->obstacles.count = 0;
+                unlockShared(data_to_main);
                 std::cout << "All obstacles cleared\n";
             }
         }
 
-        pthread_mutex_lock(&data_to_main->global_mutex);
+        if (boundary_fd != -1) {
+            drainBoundaries(boundary_fd, boundaries, shard_count, data_to_main->tick);
+        }
+
+        lockShared(data_to_main);
+        uint64_t tick = data_to_main->tick;
+        uint64_t now_ns = monotonicNs();
         
+        // Trucks that posted here recently make up this shard's part of the platoon.
+        // The order is kept between ticks: drop trucks that went quiet, append
+        // newcomers, then insertion-sort by position. Positions barely change
+        // per tick, so this is close to a single linear pass.
+        int kept = 0;
+        for (int k = 0; k < present; k++) {
+            int i = platoon_order[k];
+            if (seen_tick[i] + PRESENCE_TICKS > tick + 1 || data_to_main->rx_slots[i].request_ready) {
+                platoon_order[kept++] = i;
+            } else {
+                in_platoon[i] = false;
+            }
+        }
+        present = kept;
         for (int i = 0; i < MAX_TRUCKS; i++) {
+            if (data_to_main->rx_slots[i].request_ready) {
+                seen_tick[i] = tick + 1;
+                if (!in_platoon[i]) {
+                    in_platoon[i] = true;
+                    platoon_order[present++] = i;
+                    // A real arrival starts a fresh window. Right after a reattach the
+                    // truck was already here, so keep its window unless it went stale.
+                    TruckHistory& h = data_to_main->history[i];
+                    bool adopt = tick < adopt_until_tick && h.last_sample_ns != 0 &&
+                                 now_ns - h.last_sample_ns <= HISTORY_STALE_NS;
+                    if (!adopt) historyReset(h);
+                }
+            }
+        }
+        
+        // Rear to front by road position; the truck ahead is the next one in order
+        const rxMainMessageFrame* rx = data_to_main->rx_slots;
+        for (int k = 1; k < present; k++) {
+            int i = platoon_order[k];
+            int j = k - 1;
+            while (j >= 0 && (rx[platoon_order[j]].position > rx[i].position ||
+                              (rx[platoon_order[j]].position == rx[i].position && platoon_order[j] > i))) {
+                platoon_order[j + 1] = platoon_order[j];
+                j--;
+            }
+            platoon_order[j + 1] = i;
+        }
+        
+        // Past our front edge, the nearest truck is the rear of a shard ahead
+        unsigned short boundary_position = 0;
+        bool has_boundary = frontBoundary(boundaries, shard_index, shard_count, tick, &boundary_position);
+        unsigned short boundary_obstacle = 0;
+        bool has_boundary_obstacle = frontObstacle(boundaries, shard_index, shard_count, tick, &boundary_obstacle);
+        
+        // Obstacles are merged with the platoon in the same rear-to-front pass:
+        // the cursor only moves forward, and each truck binary-searches from
+        // where the truck behind it stopped
+        const RoadObstacle* lane_begin;
+        const RoadObstacle* lane_end;
+        obstacleLane(data_to_main->obstacles, PLATOON_LANE, &lane_begin, &lane_end);
+        const RoadObstacle* obstacle_cursor = lane_begin;
+        sensor_batch.count = 0;
+        
+        for (int k = 0; k < present; k++) {
+            int i = platoon_order[k];
             if (data_to_main->rx_slots[i].request_ready == true) {
                 
                 unsigned short truck_position = data_to_main->rx_slots[i].position;
                 
-                // Calculate distance to front truck (fix the bug from original code)
+                // Calculate distance to front truck
+                bool has_front = (k + 1 < present) || has_boundary;
+                unsigned short front_position = (k + 1 < present)
+                    ? data_to_main->rx_slots[platoon_order[k + 1]].position
+                    : boundary_position;
+                
                 unsigned short distance_result;
-                if (i == 0) {
-                    // First truck (leader) has clear road ahead
-                    distance_result = 100;
+                if (!has_front) {
+                    // Front of the platoon has clear road ahead
+                    distance_result = CLEAR_ROAD_DISTANCE;
+                } else if (front_position > truck_position) {
+                    distance_result = front_position - truck_position;
                 } else {
-                    // Calculate distance to truck in front
-                    unsigned short front_position = data_to_main->rx_slots[i - 1].position;
-                    if (front_position > truck_position) {
-                        distance_result = front_position - truck_position;
-                    } else {
-                        distance_result = 0;  // Safety: shouldn't happen
-                    }
+                    distance_result = 0;  // Same spot: treat as touching
+                }
+                
+                // Nearest obstacle ahead, here or on a shard ahead
+                obstacle_cursor = std::lower_bound(obstacle_cursor, lane_end,
+                                                   RoadObstacle{PLATOON_LANE, truck_position}, obstacleLess);
+                unsigned short obstacle_distance = NO_OBSTACLE;
+                if (obstacle_cursor != lane_end) {
+                    obstacle_distance = obstacle_cursor->position - truck_position;
+                } else if (has_boundary_obstacle && boundary_obstacle >= truck_position) {
+                    obstacle_distance = boundary_obstacle - truck_position;
                 }
+                bool obstacle_in_path = obstacle_distance != NO_OBSTACLE &&
+                                        isObstacleInPath(obstacle_distance, data_to_main->rx_slots[i].speed);
                 
                 std::cout << "Truck " << i << " at position " << truck_position 
-                          << ", distance to front: " << distance_result << " m\n";
+                          << ", distance to front: " << distance_result << " m";
+                if (obstacle_distance != NO_OBSTACLE) {
+                    std::cout << ", obstacle ahead: " << obstacle_distance << " m";
+                }
+                std::cout << "\n";
                 
-                // Send sensor data back to truck
+                // Send sensor data back to truck; with a sensor model configured
+                // the batched stage below overwrites it before we unlock
                 data_to_main->tx_slots[i].sensor_data = distance_result;
+                historyPush(data_to_main->history[i], distance_result,
+                            data_to_main->rx_slots[i].speed, now_ns);
+                
+                int b = sensor_batch.count++;
+                sensor_batch.slot[b] = i;
+                sensor_batch.truth[b] = distance_result;
+                sensor_batch.front[b] = !has_front ? FRONT_NONE
+                                      : (k + 1 < present) ? platoon_order[k + 1] : FRONT_BOUNDARY;
+                data_to_main->tx_slots[i].obstacle_distance = obstacle_distance;
+                data_to_main->tx_slots[i].obstacle_detected = obstacle_in_path;
                 data_to_main->tx_slots[i].response_ready = true;
                 data_to_main->rx_slots[i].request_ready = false;
                 
                 // Safety check
-                if (distance_result < MIN_SAFE_DISTANCE && i > 0) {
+                if (distance_result < MIN_SAFE_DISTANCE && has_front) {
                     std::cerr << "WARNING: Truck " << i << " too close! Distance: " 
                               << distance_result << "m\n";
                 }
             }
         }
         
+        if (sensor_config.enabled) {
+            runSensorStage(data_to_main, sensor_batch, sensor_config, sensor_rng, &sensor_rotor, sensor_stats);
+        }
+        
+        bool has_rear = present > 0;
+        unsigned short rear_position = has_rear ? data_to_main->rx_slots[platoon_order[0]].position : 0;
+        bool has_obstacle = lane_begin != lane_end;
+        unsigned short first_obstacle = has_obstacle ? lane_begin->position : 0;
+        
         // Increment tick (heartbeat)
         data_to_main->tick++;
         
-        pthread_mutex_unlock(&data_to_main->global_mutex);
+        bool checkpoint_due = (data_to_main->tick % CHECKPOINT_INTERVAL_TICKS) == 0;
+        if (checkpoint_due) {
+            takeCheckpoint(data_to_main, &checkpoint);
+        }
+        
+        unlockShared(data_to_main);
         
+        if (sensor_config.enabled && sensor_stats.ticks >= (uint64_t)SENSOR_REPORT_TICKS) {
+            reportSensorStats(sensor_stats);
+        }
+        
+        if (boundary_fd != -1) {
+            sendBoundary(boundary_fd, shard_index, shard_count, has_rear, rear_position,
+                         has_obstacle, first_obstacle);
+        }
+        
+        // Disk I/O outside the lock so trucks are never stalled by it
+        if (checkpoint_due && !saveCheckpoint(checkpoint, checkpoint_path, checkpoint_tmp_path)) {
+            std::cerr << "WARNING: Failed to write checkpoint\n";
+        }
+        
+        std::cout.flush();
         sleep(1);
     }
 
     // Cleanup
-    pthread_mutex_destroy(&data_to_main->global_mutex);
+    if (detach) {
+        // Leave the segment for the next main frame; trucks keep their slots
+        lockShared(data_to_main);
+        data_to_main->main_frame_pid = 0;
+        takeCheckpoint(data_to_main, &checkpoint);
+        unlockShared(data_to_main);
+        saveCheckpoint(checkpoint, checkpoint_path, checkpoint_tmp_path);
+    } else {
+        // Clean shutdown: trucks have been told to stop, next start is cold
+        pthread_mutex_destroy(&data_to_main->global_mutex);
+        shm_unlink(name);
+        std::remove(checkpoint_path);
+    }
+    if (boundary_fd != -1) close(boundary_fd);
     munmap(data_to_main, sizeof(SharedMemoryLayout));
-    shm_unlink(name);
     close(file_descriptor);
     
     return 0;
@@ -0,0 +1,273 @@
+#include <iostream>
+#include <iomanip>
+#include <stdint.h>
+#include <cstdlib>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "common.h"
+
+// ========== Safety Sweep ==========
+//
+// Monte Carlo validation of the follower safety logic. Each episode is a
+// randomized platoon: leader behaviour, speeds, gaps, setpoint and sensor
+// latency all vary. Every follower is driven through followerControlStep(),
+// the same code runFollower uses, with the law picked by
+// PLATOON_FOLLOWER_POLICY. Gaps are measured the way the main frame measures
+// them (unsigned short, floored at 0) and delivered LATENCY ticks late; each
+// follower also sees its previous gap and the leader's published speed change.
+//
+// Each episode derives its RNG from (seed, episode index), so any failing
+// episode can be replayed on its own:  safety_sweep_use replay <seed> <episode>
+
+const int SWEEP_TICKS = 120;
+const int SWEEP_MAX_FOLLOWERS = 7;
+const int SWEEP_MAX_LATENCY = 2;       // ticks between measurement and use
+const int SWEEP_LEADER_WANDER = 1;     // leader accel range when not braking
+const int SWEEP_CHUNK = 4096;            // episodes claimed per work unit
+const int SWEEP_REPORTED_FAILURES = 5;
+
+// Small deterministic RNG; std distributions differ between standard libraries
+struct SplitMix64 {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [lo, hi]
+    int range(int lo, int hi) {
+        return lo + (int)(next() % (uint64_t)(hi - lo + 1));
+    }
+};
+
+struct EpisodeResult {
+    bool collision;
+    int collision_tick;
+    uint32_t brake_triggers;      // collision-risk emergencies
+    uint32_t false_brakes;        // of those, ones the true state did not need
+    uint32_t unsafe_ticks;        // true state unsafe, follower not braking
+    uint32_t follower_ticks;
+};
+
+struct SweepTotals {
+    uint64_t episodes;
+    uint64_t collisions;
+    uint64_t brake_triggers;
+    uint64_t false_brakes;
+    uint64_t unsafe_ticks;
+    uint64_t follower_ticks;
+    std::vector<uint64_t> failing;   // first few colliding episode indices
+};
+
+// Exact stopping distance, without the unsigned short truncation
+double exactStoppingDistance(double speed) {
+    return speed * speed / (2.0 * EMERGENCY_DECEL);
+}
+
+// Safe if we can stop behind the truck ahead even when it brakes at full
+// deceleration, allowing one tick of travel before our brake takes effect.
+bool trulySafe(double gap, double own_speed, double front_speed) {
+    return gap + exactStoppingDistance(front_speed) >= own_speed + exactStoppingDistance(own_speed);
+}
+
+EpisodeResult runEpisode(uint64_t seed, uint64_t episode, bool verbose) {
+    SplitMix64 rng{seed ^ (episode * 0xD1B54A32D192ED03ULL)};
+    EpisodeResult result{false, -1, 0, 0, 0, 0};
+
+    int followers = rng.range(1, SWEEP_MAX_FOLLOWERS);
+    int latency = rng.range(0, SWEEP_MAX_LATENCY);
+    unsigned short setpoint = (unsigned short)(10 + 5 * rng.range(0, 6));
+    int cruise = rng.range(0, 40);
+    int brake_tick = rng.range(0, 2) == 0 ? rng.range(5, SWEEP_TICKS - 5) : -1;
+
+    // Index 0 is the leader, positions in metres, speeds in m/tick
+    int position[SWEEP_MAX_FOLLOWERS + 1];
+    unsigned short speed[SWEEP_MAX_FOLLOWERS + 1];
+    bool emergency[SWEEP_MAX_FOLLOWERS + 1] = {};
+    unsigned short prev_distance[SWEEP_MAX_FOLLOWERS + 1];
+    unsigned short measured[SWEEP_MAX_LATENCY + 1][SWEEP_MAX_FOLLOWERS + 1] = {};
+    bool leader_emergency_seen[SWEEP_MAX_LATENCY + 1] = {};
+
+    position[0] = 10000;
+    speed[0] = (unsigned short)cruise;
+    // Start near steady state: roughly at the setpoint, roughly at cruise speed
+    for (int i = 1; i <= followers; i++) {
+        position[i] = position[i - 1] - std::max(5, setpoint + rng.range(-5, 15));
+        speed[i] = (unsigned short)std::max(0, cruise + rng.range(-2, 2));
+        prev_distance[i] = (unsigned short)(position[i - 1] - position[i]);
+    }
+
+    if (verbose) {
+        std::cout << "episode " << episode << ": followers=" << followers << " latency=" << latency
+                  << " setpoint=" << setpoint << " cruise=" << cruise << " brake_tick=" << brake_tick << "\n";
+    }
+
+    bool leader_braking = false;
+    int leader_accel = 0;
+
+    for (int tick = 0; tick < SWEEP_TICKS; tick++) {
+        // Main frame measurement this tick, delivered `latency` ticks later
+        int slot_now = tick % (SWEEP_MAX_LATENCY + 1);
+        int slot_seen = (tick - latency + (SWEEP_MAX_LATENCY + 1)) % (SWEEP_MAX_LATENCY + 1);
+        for (int i = 1; i <= followers; i++) {
+            int gap = position[i - 1] - position[i];
+            measured[slot_now][i] = (unsigned short)std::min(std::max(gap, 0), 65535);
+        }
+        if (tick == brake_tick) leader_braking = true;
+        leader_emergency_seen[slot_now] = leader_braking;
+        bool warm = tick >= latency;
+
+        // Leader: wander gently, changing every 10 ticks, or brake hard
+        int leader_before = speed[0];
+        if (leader_braking) {
+            speed[0] = speed[0] > EMERGENCY_DECEL ? (unsigned short)(speed[0] - EMERGENCY_DECEL) : 0;
+        } else {
+            if (tick % 10 == 0) leader_accel = rng.range(-SWEEP_LEADER_WANDER, SWEEP_LEADER_WANDER);
+            speed[0] = (unsigned short)clampValue(speed[0] + leader_accel, 0, SPEED_MAX);
+        }
+        int published_accel = speed[0] - leader_before;
+
+        for (int i = 1; i <= followers; i++) {
+            unsigned short distance = warm ? measured[slot_seen][i] : measured[slot_now][i];
+            double true_gap = position[i - 1] - position[i];
+            bool safe = trulySafe(true_gap, speed[i], speed[i - 1]);
+
+            if (warm && leader_emergency_seen[slot_seen] && !emergency[i]) {
+                emergency[i] = true;
+            }
+
+            bool was_emergency = emergency[i];
+            FollowerStepResult step = followerControlStep(speed[i], emergency[i], distance, prev_distance[i],
+                                                          setpoint, published_accel);
+            prev_distance[i] = distance;
+
+            if (step.collision_risk) {
+                result.brake_triggers++;
+                if (safe) result.false_brakes++;
+            }
+            if (!safe && !was_emergency && !step.collision_risk) result.unsafe_ticks++;
+            result.follower_ticks++;
+        }
+
+        // Move everyone, then check for contact
+        for (int i = 0; i <= followers; i++) position[i] += speed[i];
+
+        for (int i = 1; i <= followers; i++) {
+            if (position[i] >= position[i - 1]) {
+                result.collision = true;
+                result.collision_tick = tick;
+            }
+        }
+
+        if (verbose) {
+            std::cout << "  t=" << std::setw(3) << tick << " L v=" << std::setw(2) << speed[0]
+                      << (leader_braking ? "B" : " ");
+            for (int i = 1; i <= followers; i++) {
+                std::cout << " | gap=" << std::setw(4) << position[i - 1] - position[i]
+                          << " v=" << std::setw(2) << speed[i] << (emergency[i] ? "E" : " ");
+            }
+            std::cout << "\n";
+        }
+        if (result.collision) break;
+    }
+    return result;
+}
+
+// Counts go into a local copy and are written out once: adjacent entries of
+// the per-thread vector share cache lines, and bumping them per episode
+// would bounce those lines between cores.
+void sweepWorker(uint64_t seed, uint64_t episodes, std::atomic<uint64_t>* next_chunk, SweepTotals* out) {
+    SweepTotals local{0, 0, 0, 0, 0, 0, {}};
+    while (true) {
+        uint64_t begin = next_chunk->fetch_add(SWEEP_CHUNK);
+        if (begin >= episodes) break;
+        uint64_t end = std::min(begin + SWEEP_CHUNK, episodes);
+
+        for (uint64_t e = begin; e < end; e++) {
+            EpisodeResult r = runEpisode(seed, e, false);
+            local.episodes++;
+            local.brake_triggers += r.brake_triggers;
+            local.false_brakes += r.false_brakes;
+            local.unsafe_ticks += r.unsafe_ticks;
+            local.follower_ticks += r.follower_ticks;
+            if (r.collision) {
+                local.collisions++;
+                if (local.failing.size() < SWEEP_REPORTED_FAILURES) local.failing.push_back(e);
+            }
+        }
+    }
+    *out = std::move(local);
+}
+
+double rate(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::string(argv[1]) == "replay") {
+        if (argc != 4) {
+            std::cerr << "Usage: " << argv[0] << " replay <seed> <episode>\n";
+            return 1;
+        }
+        uint64_t seed = std::strtoull(argv[2], nullptr, 10);
+        uint64_t episode = std::strtoull(argv[3], nullptr, 10);
+        EpisodeResult r = runEpisode(seed, episode, true);
+        std::cout << (r.collision ? "COLLISION at tick " : "no collision") ;
+        if (r.collision) std::cout << r.collision_tick;
+        std::cout << ", brake triggers " << r.brake_triggers << " (false " << r.false_brakes << ")\n";
+        return r.collision ? 2 : 0;
+    }
+
+    uint64_t episodes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+    int threads = argc > 3 ? std::atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+
+    std::cout << "Sweeping " << episodes << " episodes, seed " << seed << ", " << threads << " threads\n";
+
+    uint64_t t0 = monotonicNs();
+    std::atomic<uint64_t> next_chunk{0};
+    std::vector<SweepTotals> per_thread(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        per_thread[t] = SweepTotals{0, 0, 0, 0, 0, 0, {}};
+        workers.emplace_back(sweepWorker, seed, episodes, &next_chunk, &per_thread[t]);
+    }
+    for (auto& w : workers) w.join();
+    double elapsed_s = (monotonicNs() - t0) / 1e9;
+
+    SweepTotals total{0, 0, 0, 0, 0, 0, {}};
+    for (auto& t : per_thread) {
+        total.episodes += t.episodes;
+        total.collisions += t.collisions;
+        total.brake_triggers += t.brake_triggers;
+        total.false_brakes += t.false_brakes;
+        total.unsafe_ticks += t.unsafe_ticks;
+        total.follower_ticks += t.follower_ticks;
+        total.failing.insert(total.failing.end(), t.failing.begin(), t.failing.end());
+    }
+    std::sort(total.failing.begin(), total.failing.end());
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  collisions:        " << total.collisions << " episodes ("
+              << rate(total.collisions, total.episodes) << "%)\n";
+    std::cout << "  brake triggers:    " << total.brake_triggers << ", false "
+              << total.false_brakes << " (" << rate(total.false_brakes, total.brake_triggers) << "%)\n";
+    std::cout << "  unsafe, no brake:  " << total.unsafe_ticks << " follower-ticks ("
+              << rate(total.unsafe_ticks, total.follower_ticks) << "%)\n";
+    std::cout << "  throughput:        " << std::setprecision(0) << total.episodes / elapsed_s
+              << " episodes/s (" << std::setprecision(2) << elapsed_s << " s)\n";
+
+    for (size_t k = 0; k < total.failing.size() && k < (size_t)SWEEP_REPORTED_FAILURES; k++) {
+        std::cout << "  replay: " << argv[0] << " replay " << seed << " " << total.failing[k] << "\n";
+    }
+
+    return total.collisions ? 2 : 0;
+}
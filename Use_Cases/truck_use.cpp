@@ -4,38 +4,264 @@
 #include <iostream>
 #include <pthread.h>
 #include <stdint.h>
+#include <time.h>
+#include <cmath>
+#include <coroutine>
+#include <exception>
+#include <queue>
+#include <vector>
 #include "common.h"
 
+// ========== Coroutine Runtime ==========
+//
+// Every truck is a coroutine on one single-threaded executor. Where the
+// old loops called usleep(), they now co_await exec.sleepFor(), so one
+// process can drive a whole swarm of trucks through the same shared memory
+// protocol.
+
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+        T result{};
+        std::coroutine_handle<> continuation;
+        int* live_roots = nullptr;   // set for top-level tasks owned by the executor
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                promise_type& p = h.promise();
+                if (p.continuation) return p.continuation;
+                if (p.live_roots) (*p.live_roots)--;
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_value(T value) { result = value; }
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    Task(Task&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    Task(const Task&) = delete;
+    ~Task() { if (handle) handle.destroy(); }
+
+    // Awaiting a task runs it to completion, then resumes the awaiter
+    bool await_ready() { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+    T await_resume() { return handle.promise().result; }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+class Executor {
+public:
+    struct SleepAwaiter {
+        Executor& exec;
+        uint64_t wake_ns;
+        bool await_ready() { return false; }
+        void await_suspend(std::coroutine_handle<> h) { exec.schedule(wake_ns, h); }
+        void await_resume() {}
+    };
+
+    SleepAwaiter sleepFor(int ms) {
+        return SleepAwaiter{*this, monotonicNs() + (uint64_t)ms * 1000000ULL};
+    }
+
+    template <typename T>
+    void spawn(Task<T>&& task) {
+        task.handle.promise().live_roots = &live_roots;
+        live_roots++;
+        schedule(0, task.handle);
+        roots.push_back(std::move(task.handle));
+        task.handle = nullptr;
+    }
+
+    // Run until every spawned task has finished
+    void run() {
+        while (live_roots > 0 && !timers.empty()) {
+            uint64_t wake_ns = timers.top().wake_ns;
+            uint64_t now = monotonicNs();
+            if (wake_ns > now) {
+                std::cout.flush();   // unsynced stream, see main()
+                timespec ts;
+                ts.tv_sec = wake_ns / 1000000000ULL;
+                ts.tv_nsec = wake_ns % 1000000000ULL;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+            }
+
+            // Resume everything that is due, in schedule order
+            now = monotonicNs();
+            while (!timers.empty() && timers.top().wake_ns <= now) {
+                std::coroutine_handle<> h = timers.top().handle;
+                timers.pop();
+                h.resume();
+            }
+        }
+        for (auto h : roots) h.destroy();
+        roots.clear();
+    }
+
+private:
+    struct Timer {
+        uint64_t wake_ns;
+        uint64_t order;   // FIFO among equal wake times
+        std::coroutine_handle<> handle;
+        bool operator>(const Timer& other) const {
+            return wake_ns != other.wake_ns ? wake_ns > other.wake_ns : order > other.order;
+        }
+    };
+
+    void schedule(uint64_t wake_ns, std::coroutine_handle<> h) {
+        timers.push(Timer{wake_ns, next_order++, h});
+    }
+
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    std::vector<std::coroutine_handle<>> roots;
+    uint64_t next_order = 0;
+    int live_roots = 0;
+};
+
+// Per-tick status lines; turned off for swarms where they would flood the terminal
+static bool print_status = true;
+
+// ========== Role Handoff ==========
+
+// Carried across a role change so the truck keeps its place on the road
+struct RoleHandoff {
+    unsigned short position;
+    uint64_t leader_lost_ns;   // last heartbeat of the leader we replaced, 0 if none
+};
+
+enum class RoleExit { Shutdown, Promoted, Demoted };
+
+// Refresh our heartbeat and position, and take over if the leader has gone silent.
+// Caller holds the lock. Returns true if this truck just became leader.
+bool checkLeaderFailover(int slot, unsigned short position, SharedMemoryLayout* data_from_main,
+                         RoleHandoff& handoff) {
+    uint64_t now = monotonicNs();
+    data_from_main->truck_heartbeat_ns[slot] = now;
+    data_from_main->truck_position[slot] = position;
+
+    int leader = data_from_main->leader_slot;
+    if (leader < 0 || isTruckAlive(data_from_main, leader, now)) {
+        return false;   // no leader yet, or leader healthy
+    }
+    if (electLeader(data_from_main, now) != slot) {
+        return false;   // someone ahead of us wins
+    }
+
+    handoff.leader_lost_ns = data_from_main->truck_heartbeat_ns[leader];
+    data_from_main->leader_slot = slot;
+    data_from_main->leader_term++;
+    data_from_main->follower_status[slot].is_active = false;
+    data_from_main->follower_status[slot].emergency_active = false;
+    return true;
+}
+
+// ========== Shard Handoff ==========
+
+// Move our slot to the shard that now owns our position
+SharedMemoryLayout* followRoad(int slot, ShardMap& shards, SharedMemoryLayout* road, unsigned short position) {
+    SharedMemoryLayout* next = shards.road(position);
+    if (next == road) return road;
+
+    lockShared(road);
+    road->rx_slots[slot].request_ready = false;
+    unlockShared(road);
+
+    if (print_status) {
+        std::cout << "[Truck " << slot << "] Handoff to shard " << next->shard_index
+                  << " at position " << position << "\n";
+    }
+    return next;
+}
+
+// Window statistics for a slot from whichever shard sampled it most recently
+TruckWindowStats followerWindow(ShardMap& shards, int slot) {
+    TruckWindowStats best{0, 0, 0, 0.0, 0.0, 0.0};
+    uint64_t best_ns = 0;
+    for (int k = 0; k < shards.count; k++) {
+        SharedMemoryLayout* segment = shards.segments[k];
+        lockShared(segment);
+        const TruckHistory& h = segment->history[slot];
+        if (h.last_sample_ns > best_ns) {
+            best_ns = h.last_sample_ns;
+            best = historyStats(h);
+        }
+        unlockShared(segment);
+    }
+    return best;
+}
+
 // ========== Follower Truck ==========
 
-void runFollower(int slot, SharedMemoryLayout* data_from_main) {
+Task<RoleExit> runFollower(Executor& exec, int slot, ShardMap& shards, RoleHandoff& handoff) {
     unsigned short speed = 0;
-    unsigned short position = slot * 100 + 100;  // Starting positions
+    unsigned short position = handoff.position;
     unsigned short desired_distance = 20;
+    int leader_accel = 0;
+    int prev_distance = -1;   // gap measured on the previous step, -1 before the first
     bool emergency_mode = false;
     uint64_t last_tick = 0;
     int missed_ticks = 0;
 
+    SharedMemoryLayout* coord = shards.coord();
+    SharedMemoryLayout* road = shards.road(position);
+
     std::cout << "[Follower " << slot << "] Starting at position " << position << "\n";
 
     // Register as active follower
-    pthread_mutex_lock(&data_from_main->global_mutex);
-    data_from_main->follower_status[slot].is_active = true;
-    pthread_mutex_unlock(&data_from_main->global_mutex);
+    lockShared(coord);
+    coord->follower_status[slot].is_active = true;
+    coord->truck_heartbeat_ns[slot] = monotonicNs();
+    coord->truck_position[slot] = position;
+    unlockShared(coord);
 
-    while (true) {
-        pthread_mutex_lock(&data_from_main->global_mutex);
+    RoleExit exit_reason = RoleExit::Shutdown;
+    AllocWatch alloc_watch{"follower", 0, 0, 0};
+
+    while (exit_reason == RoleExit::Shutdown) {
+        allocCheckTick(alloc_watch);
+        
+        SharedMemoryLayout* next_road = followRoad(slot, shards, road, position);
+        if (next_road != road) {
+            road = next_road;
+            last_tick = 0;   // each shard counts its own ticks
+        }
+        
+        lockShared(coord);
+        bool running = coord->system_running;
+        bool promoted = running && checkLeaderFailover(slot, position, coord, handoff);
+        unlockShared(coord);
+        
+        if (promoted) {
+            exit_reason = RoleExit::Promoted;
+            break;
+        }
+        
+        lockShared(road);
         
         // Check if system is still running
-        if (!data_from_main->system_running) {
-            pthread_mutex_unlock(&data_from_main->global_mutex);
+        if (!running || !road->system_running) {
+            unlockShared(road);
             std::cout << "[Follower " << slot << "] System shutdown\n";
             break;
         }
         
         // Check heartbeat (tick)
-        if (data_from_main->tick > last_tick) {
-            last_tick = data_from_main->tick;
+        if (road->tick > last_tick) {
+            last_tick = road->tick;
             missed_ticks = 0;
         } else {
             missed_ticks++;
@@ -46,27 +272,31 @@ void runFollower(int slot, SharedMemoryLayout* data_from_main) {
         }
         
         // Send position to main_frame
-        data_from_main->rx_slots[slot].position = position;
-        data_from_main->rx_slots[slot].speed = speed;
-        data_from_main->rx_slots[slot].emergency_brake = emergency_mode;
-        data_from_main->rx_slots[slot].request_ready = true;
-        data_from_main->tx_slots[slot].response_ready = false;
+        road->rx_slots[slot].position = position;
+        road->rx_slots[slot].speed = speed;
+        road->rx_slots[slot].emergency_brake = emergency_mode;
+        road->rx_slots[slot].request_ready = true;
+        road->tx_slots[slot].response_ready = false;
         
-        pthread_mutex_unlock(&data_from_main->global_mutex);
+        unlockShared(road);
         
         // Wait for response from main_frame
         while (true) {
-            pthread_mutex_lock(&data_from_main->global_mutex);
+            lockShared(road);
             
-            if (data_from_main->tx_slots[slot].response_ready == true) {
-                unsigned short distance = data_from_main->tx_slots[slot].sensor_data;
-                bool obstacle = data_from_main->tx_slots[slot].obstacle_detected;
+            if (road->tx_slots[slot].response_ready == true) {
+                unsigned short distance = road->tx_slots[slot].sensor_data;
+                bool obstacle = road->tx_slots[slot].obstacle_detected;
+                unlockShared(road);
+                
+                lockShared(coord);
                 
                 // Read leader commands
-                desired_distance = data_from_main->leader_cmd.distance_setpoint;
+                desired_distance = coord->leader_cmd.distance_setpoint;
+                leader_accel = coord->leader_cmd.leader_accel;
                 
                 // Check for leader emergency
-                if (data_from_main->leader_cmd.emergency_brake_all && !emergency_mode) {
+                if (coord->leader_cmd.emergency_brake_all && !emergency_mode) {
                     std::cout << "[Follower " << slot << "] Leader emergency signal!\n";
                     emergency_mode = true;
                 }
@@ -75,106 +305,149 @@ void runFollower(int slot, SharedMemoryLayout* data_from_main) {
                 if (obstacle && !emergency_mode) {
                     std::cout << "[Follower " << slot << "] OBSTACLE detected!\n";
                     emergency_mode = true;
-                    data_from_main->follower_status[slot].emergency_active = true;
+                    coord->follower_status[slot].emergency_active = true;
                 }
                 
                 // Update follower status
-                data_from_main->follower_status[slot].actual_distance = distance;
+                coord->follower_status[slot].actual_distance = distance;
+                
+                unlockShared(coord);
                 
-                pthread_mutex_unlock(&data_from_main->global_mutex);
+                unsigned short last_distance = prev_distance < 0 ? distance : (unsigned short)prev_distance;
+                prev_distance = distance;
+                FollowerStepResult step = followerControlStep(speed, emergency_mode, distance, last_distance,
+                                                              desired_distance, leader_accel);
                 
-                // Safety check: collision risk?
-                if (!emergency_mode && isCollisionRisk(distance, speed)) {
+                if (step.collision_risk) {
                     std::cout << "[Follower " << slot << "] Collision risk!\n";
-                    emergency_mode = true;
                     
-                    pthread_mutex_lock(&data_from_main->global_mutex);
-                    data_from_main->follower_status[slot].emergency_active = true;
-                    pthread_mutex_unlock(&data_from_main->global_mutex);
+                    lockShared(coord);
+                    coord->follower_status[slot].emergency_active = true;
+                    unlockShared(coord);
                 }
                 
-                // Control logic
-                if (emergency_mode) {
-                    // Emergency brake
-                    if (speed > EMERGENCY_DECEL) {
-                        speed -= EMERGENCY_DECEL;
-                    } else {
-                        speed = 0;
-                        emergency_mode = false;  // Stopped safely
-                        
-                        pthread_mutex_lock(&data_from_main->global_mutex);
-                        data_from_main->follower_status[slot].emergency_active = false;
-                        pthread_mutex_unlock(&data_from_main->global_mutex);
-                    }
-                } else {
-                    // Normal distance control
-                    int error = distance - desired_distance;
-                    int accel = error / 5;  // Proportional control
-                    
-                    if (accel > 2) accel = 2;
-                    if (accel < -3) accel = -3;
-                    
-                    speed += accel;
-                    if (speed > 50) speed = 50;  // Max speed
+                if (step.stopped) {
+                    lockShared(coord);
+                    coord->follower_status[slot].emergency_active = false;
+                    unlockShared(coord);
                 }
                 
                 // Update position based on speed
                 position += speed;
                 
                 // Display status
-                std::string status = emergency_mode ? "EMERGENCY" : "NORMAL";
-                std::string safe = isSafeDistance(distance) ? "SAFE" : "UNSAFE";
+                const char* status = emergency_mode ? "EMERGENCY" : "NORMAL";
+                const char* safe = isSafeDistance(distance) ? "SAFE" : "UNSAFE";
                 
-                std::cout << "[Follower " << slot << "] "
-                          << "pos=" << position
-                          << " speed=" << speed
-                          << " dist=" << distance 
-                          << " [" << status << "/" << safe << "]\n";
+                if (print_status) {
+                    std::cout << "[Follower " << slot << "] "
+                              << "pos=" << position
+                              << " speed=" << speed
+                              << " dist=" << distance 
+                              << " [" << status << "/" << safe << "]\n";
+                }
                 
                 break;
             }
+            unlockShared(road);
             
-            pthread_mutex_unlock(&data_from_main->global_mutex);
-            usleep(100000);  // 100ms
+            lockShared(coord);
+            promoted = checkLeaderFailover(slot, position, coord, handoff);
+            unlockShared(coord);
+            if (promoted) {
+                exit_reason = RoleExit::Promoted;
+                break;
+            }
+            co_await exec.sleepFor(HEARTBEAT_PERIOD_MS);
         }
         
-        sleep(1);
+        // Sleep out the rest of the tick in heartbeat-sized slices
+        for (int t = 0; t < 1000 / HEARTBEAT_PERIOD_MS && exit_reason == RoleExit::Shutdown; t++) {
+            co_await exec.sleepFor(HEARTBEAT_PERIOD_MS);
+            lockShared(coord);
+            if (checkLeaderFailover(slot, position, coord, handoff)) {
+                exit_reason = RoleExit::Promoted;
+            }
+            unlockShared(coord);
+        }
+    }
+    
+    handoff.position = position;
+    
+    if (exit_reason == RoleExit::Promoted) {
+        std::cout << "[Follower " << slot << "] Leader lost, taking over\n";
+        co_return exit_reason;
     }
     
     // Cleanup
-    pthread_mutex_lock(&data_from_main->global_mutex);
-    data_from_main->follower_status[slot].is_active = false;
-    pthread_mutex_unlock(&data_from_main->global_mutex);
+    lockShared(coord);
+    coord->follower_status[slot].is_active = false;
+    coord->truck_heartbeat_ns[slot] = 0;
+    unlockShared(coord);
+    co_return exit_reason;
 }
 
 // ========== Leader Truck ==========
 
-void runLeader(int slot, SharedMemoryLayout* data_from_main) {
-    unsigned short position = slot * 100 + 100;
-    unsigned short desired_distance = 20;
-    bool emergency_brake = false;
+Task<RoleExit> runLeader(Executor& exec, int slot, ShardMap& shards, RoleHandoff& handoff) {
+    unsigned short position = handoff.position;
+    SharedMemoryLayout* data_from_main = shards.coord();
+    SharedMemoryLayout* road = shards.road(position);
+
+    // Claim the platoon unless another live leader already holds it
+    lockShared(data_from_main);
+    uint64_t now = monotonicNs();
+    int current = data_from_main->leader_slot;
+    if (current >= 0 && current != slot && isTruckAlive(data_from_main, current, now)) {
+        unlockShared(data_from_main);
+        std::cout << "[Leader " << slot << "] Slot " << current << " is already leading, joining as follower\n";
+        co_return RoleExit::Demoted;
+    }
+    if (current != slot) {
+        data_from_main->leader_slot = slot;
+        data_from_main->leader_term++;
+    }
+    data_from_main->truck_heartbeat_ns[slot] = now;
+    data_from_main->truck_position[slot] = position;
+    uint32_t term = data_from_main->leader_term;
+    
+    // Resume from the last published command so a takeover is seamless
+    unsigned short desired_distance = data_from_main->leader_cmd.distance_setpoint;
+    bool emergency_brake = data_from_main->leader_cmd.emergency_brake_all;
+    unlockShared(data_from_main);
+    unsigned short leader_speed = LEADER_SPEED;
+    unsigned short last_speed = leader_speed;
 
-    std::cout << "[Leader " << slot << "] Starting\n";
+    std::cout << "[Leader " << slot << "] Starting (term " << term << ")\n";
     std::cout << "Commands: + (increase distance), - (decrease), e (emergency), r (reset)\n";
 
+    AllocWatch alloc_watch{"leader", 0, 0, 0};
+
     while (true) {
-        pthread_mutex_lock(&data_from_main->global_mutex);
+        allocCheckTick(alloc_watch);
+        road = followRoad(slot, shards, road, position);
+        
+        lockShared(data_from_main);
+        bool running = data_from_main->system_running;
+        unlockShared(data_from_main);
         
-        if (!data_from_main->system_running) {
-            pthread_mutex_unlock(&data_from_main->global_mutex);
+        lockShared(road);
+        
+        if (!running || !road->system_running) {
+            unlockShared(road);
             std::cout << "[Leader " << slot << "] System shutdown\n";
             break;
         }
         
         // Update position
-        data_from_main->rx_slots[slot].position = position;
-        data_from_main->rx_slots[slot].request_ready = true;
-        data_from_main->tx_slots[slot].response_ready = false;
+        road->rx_slots[slot].position = position;
+        road->rx_slots[slot].request_ready = true;
+        road->tx_slots[slot].response_ready = false;
         
-        pthread_mutex_unlock(&data_from_main->global_mutex);
+        unlockShared(road);
         
         // User input
-        if (std::cin.rdbuf()->in_avail()) {
+        if (commandPending()) {
             char c;
             std::cin >> c;
             
@@ -197,9 +470,11 @@ void runLeader(int slot, SharedMemoryLayout* data_from_main) {
         }
         
         // Update leader commands
-        pthread_mutex_lock(&data_from_main->global_mutex);
+        lockShared(data_from_main);
         data_from_main->leader_cmd.distance_setpoint = desired_distance;
         data_from_main->leader_cmd.emergency_brake_all = emergency_brake;
+        data_from_main->leader_cmd.leader_accel = (short)(leader_speed - last_speed);
+        last_speed = leader_speed;
         
         // Check for follower emergencies
         for (int i = 0; i < MAX_TRUCKS; i++) {
@@ -211,79 +486,137 @@ void runLeader(int slot, SharedMemoryLayout* data_from_main) {
                 data_from_main->leader_cmd.emergency_brake_all = true;
             }
         }
-        pthread_mutex_unlock(&data_from_main->global_mutex);
+        
+        // First command after a takeover closes the failover window
+        if (handoff.leader_lost_ns != 0) {
+            uint64_t failover_ns = monotonicNs() - handoff.leader_lost_ns;
+            data_from_main->last_failover_ms = (uint32_t)(failover_ns / 1000000ULL);
+            handoff.leader_lost_ns = 0;
+            std::cout << "[Leader " << slot << "] Failover complete in "
+                      << data_from_main->last_failover_ms << " ms\n";
+        }
+        unlockShared(data_from_main);
         
         // Display platoon status
         std::cout << "\n=== PLATOON STATUS ===\n";
         std::cout << "Leader at slot " << slot 
                   << " | Desired distance: " << desired_distance << "m"
-                  << " | Emergency: " << (emergency_brake ? "YES" : "NO") << "\n";
+                  << " | Emergency: " << (emergency_brake ? "YES" : "NO")
+                  << " | Term: " << term << "\n";
         
-        pthread_mutex_lock(&data_from_main->global_mutex);
         for (int i = 0; i < MAX_TRUCKS; i++) {
-            if (data_from_main->follower_status[i].is_active) {
-                std::cout << "  Follower " << i 
-                          << ": distance=" << data_from_main->follower_status[i].actual_distance << "m"
-                          << " emergency=" << (data_from_main->follower_status[i].emergency_active ? "YES" : "NO")
-                          << "\n";
+            lockShared(data_from_main);
+            FollowerReportFrame status = data_from_main->follower_status[i];
+            unlockShared(data_from_main);
+            if (!status.is_active) continue;
+            
+            TruckWindowStats window = followerWindow(shards, i);
+            std::cout << "  Follower " << i 
+                      << ": distance=" << status.actual_distance << "m"
+                      << " emergency=" << (status.emergency_active ? "YES" : "NO");
+            if (window.samples > 0) {
+                std::cout << " | last " << window.samples << "s: min gap=" << window.min_gap << "m"
+                          << " gap sd=" << std::sqrt(window.gap_variance) << "m"
+                          << " avg speed=" << window.mean_speed;
             }
+            std::cout << "\n";
         }
-        pthread_mutex_unlock(&data_from_main->global_mutex);
         
-        position += 10;  // Leader moves forward
-        sleep(1);
+        position += leader_speed;  // Leader moves forward
+        
+        // Sleep out the tick in heartbeat-sized slices so followers see us alive
+        for (int t = 0; t < 1000 / HEARTBEAT_PERIOD_MS; t++) {
+            co_await exec.sleepFor(HEARTBEAT_PERIOD_MS);
+            lockShared(data_from_main);
+            if (data_from_main->leader_slot != slot) {
+                // We stalled long enough to be replaced; step back
+                int successor = data_from_main->leader_slot;
+                unlockShared(data_from_main);
+                std::cout << "[Leader " << slot << "] Superseded by slot " << successor << "\n";
+                handoff.position = position;
+                handoff.leader_lost_ns = 0;
+                co_return RoleExit::Demoted;
+            }
+            data_from_main->truck_heartbeat_ns[slot] = monotonicNs();
+            data_from_main->truck_position[slot] = position;
+            unlockShared(data_from_main);
+        }
+    }
+    
+    // Cleanup
+    lockShared(data_from_main);
+    if (data_from_main->leader_slot == slot) {
+        data_from_main->leader_slot = -1;
     }
+    data_from_main->truck_heartbeat_ns[slot] = 0;
+    unlockShared(data_from_main);
+    handoff.position = position;
+    co_return RoleExit::Shutdown;
+}
+
+// ========== Truck Lifecycle ==========
+
+// A truck may switch roles on failover, so loop until shutdown
+Task<RoleExit> runTruck(Executor& exec, int slot, bool leading, ShardMap& shards) {
+    RoleHandoff handoff{startPosition(slot), 0};
+    RoleExit exit_reason;
+    do {
+        allocCheckRearm();   // the role coroutine below allocates its frame
+        if (leading) {
+            exit_reason = co_await runLeader(exec, slot, shards, handoff);
+        } else {
+            exit_reason = co_await runFollower(exec, slot, shards, handoff);
+        }
+        leading = !leading;
+    } while (exit_reason != RoleExit::Shutdown);
+    co_return exit_reason;
 }
 
 // ========== Main ==========
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <slot 0-7> <role l/f>\n";
+    // The leader's commandPending() poll relies on in_avail(), which libstdc++
+    // only answers for unsynced streams; the executor flushes cout before sleeping
+    std::ios::sync_with_stdio(false);
+    
+    if (argc != 3 && !(argc == 4 && argv[2][0] == 's')) {
+        std::cerr << "Usage: " << argv[0] << " <slot 0-" << (MAX_TRUCKS-1) << "> <role l/f>\n";
+        std::cerr << "       " << argv[0] << " <first slot> s <count>\n";
         std::cerr << "Example: " << argv[0] << " 0 l  (leader at slot 0)\n";
         std::cerr << "Example: " << argv[0] << " 1 f  (follower at slot 1)\n";
+        std::cerr << "Example: " << argv[0] << " 1 s 500  (followers at slots 1-500, one thread)\n";
         return 1;
     }
 
     int slot = std::atoi(argv[1]);
     char role = argv[2][0];
+    int count = (role == 's') ? std::atoi(argv[3]) : 1;
     
-    if (slot < 0 || slot >= MAX_TRUCKS) {
-        std::cerr << "Slot must be 0-" << (MAX_TRUCKS-1) << "\n";
+    if (slot < 0 || count < 1 || slot + count > MAX_TRUCKS) {
+        std::cerr << "Slots must be within 0-" << (MAX_TRUCKS-1) << "\n";
         return 1;
     }
 
-    const char* name = "/main_frame_memory";
-
-    int file_descriptor = shm_open(name, O_RDWR, 0666);
-    if (file_descriptor == -1) {
-        std::cerr << "Cannot open shared memory. Is main_frame running?\n";
-        return 1;
-    }
+    ShardMap shards{};
+    if (!attachShards(shards)) return 1;
 
-    auto* data_from_main = (SharedMemoryLayout*) mmap(
-        nullptr,
-        sizeof(SharedMemoryLayout),
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
-        file_descriptor,
-        0
-    );
-
-    if (data_from_main == MAP_FAILED) {
-        std::cerr << "Failed to map shared memory\n";
-        return 1;
+    Executor exec;
+    if (role == 's') {
+        print_status = false;
+        std::cout << "Swarm: " << count << " followers at slots " << slot
+                  << "-" << (slot + count - 1) << " on one thread, starting "
+                  << START_SPACING << " m apart\n";
+        if (START_SPACING < MIN_SAFE_DISTANCE) {
+            std::cout << "Note: this build's start spacing is below the "
+                      << MIN_SAFE_DISTANCE << " m safe distance\n";
+        }
     }
-
-    if (role == 'l') {
-        runLeader(slot, data_from_main);
-    } else {
-        runFollower(slot, data_from_main);
+    for (int i = 0; i < count; i++) {
+        exec.spawn(runTruck(exec, slot + i, role == 'l', shards));
     }
+    exec.run();
 
-    // Cleanup
-    munmap(data_from_main, sizeof(SharedMemoryLayout));
-    close(file_descriptor);
+    detachShards(shards);
     
     return 0;
 }
@@ -5,6 +5,7 @@
 #include <mqueue.h>
 #include <unistd.h>
 #include "common.h"
+#include "wire.h"
 
 // ---------- helpers ----------
 std::string hbQueue(int id) {
@@ -17,12 +18,18 @@ std::string sensorQueue(int id) {
 
 struct WorldTruck {
     double position;
+    mqd_t hb;        // kept open so the tick loop never builds queue names
+    mqd_t sensor;
 };
 
 int main() {
     std::unordered_map<int, WorldTruck> trucks;
+    std::vector<int> order;   // only rebuilt on registration
+    order.reserve(WIRE_MAX_TRUCKS);
     uint64_t tick = 0;
 
+    uint8_t frame[WIRE_MAX_VALUE_FRAME];
+
     std::cout << "MainFrame running\n";
     std::cout << "Type truck ID + Enter to register\n";
 
@@ -32,56 +39,53 @@ int main() {
             int id;
             std::cin >> id;
 
-            trucks[id] = {0.0};
+            if (trucks.count(id) == 0) {
+                mq_attr attr{};
+                attr.mq_maxmsg = 10;
+
+                attr.mq_msgsize = sizeof(Heartbeat);
+                mqd_t hb = mq_open(hbQueue(id).c_str(),
+                                   O_CREAT | O_WRONLY | O_NONBLOCK,
+                                   0666, &attr);
 
-            mq_attr attr{};
-            attr.mq_maxmsg = 10;
+                attr.mq_msgsize = WIRE_MAX_VALUE_FRAME;
+                mqd_t sensor = mq_open(sensorQueue(id).c_str(),
+                                       O_CREAT | O_WRONLY | O_NONBLOCK,
+                                       0666, &attr);
 
-            attr.mq_msgsize = sizeof(Heartbeat);
-            mq_open(hbQueue(id).c_str(),
-                    O_CREAT | O_WRONLY | O_NONBLOCK,
-                    0666, &attr);
+                trucks[id] = {0.0, hb, sensor};
 
-            attr.mq_msgsize = sizeof(SensorMsg);
-            mq_open(sensorQueue(id).c_str(),
-                    O_CREAT | O_WRONLY | O_NONBLOCK,
-                    0666, &attr);
+                order.clear();
+                for (auto& p : trucks)
+                    order.push_back(p.first);
+            }
 
             std::cout << "Registered truck " << id << "\n";
         }
 
         // ---- simple ordered spacing ----
-        std::vector<int> order;
-        for (auto& p : trucks)
-            order.push_back(p.first);
 
         for (size_t i = 0; i < order.size(); ++i)
             trucks[order[i]].position = i * 25.0;
 
         // ---- send sensors ----
         for (size_t i = 1; i < order.size(); ++i) {
-            SensorMsg s{};
-            s.distanceToFront =
+            double distanceToFront =
                 trucks[order[i - 1]].position -
                 trucks[order[i]].position;
 
-            mqd_t mq = mq_open(sensorQueue(order[i]).c_str(),
-                               O_WRONLY | O_NONBLOCK);
-            if (mq != -1) {
-                mq_send(mq, (char*)&s, sizeof(s), 0);
-                mq_close(mq);
-            }
+            size_t len = wireEncodeValue(frame, WireType::Sensor, distanceToFront);
+
+            mqd_t mq = trucks[order[i]].sensor;
+            if (mq != -1)
+                mq_send(mq, (char*)frame, len, 0);
         }
 
         // ---- heartbeat ----
         for (auto& p : trucks) {
             Heartbeat hb{tick};
-            mqd_t mq = mq_open(hbQueue(p.first).c_str(),
-                               O_WRONLY | O_NONBLOCK);
-            if (mq != -1) {
-                mq_send(mq, (char*)&hb, sizeof(hb), 0);
-                mq_close(mq);
-            }
+            if (p.second.hb != -1)
+                mq_send(p.second.hb, (char*)&hb, sizeof(hb), 0);
         }
 
         tick++;
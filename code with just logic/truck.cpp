@@ -1,11 +1,13 @@
 #include <iostream>
-#include <map>
+#include <vector>
+#include <algorithm>
 #include <iomanip>
 #include <string>
 #include <mqueue.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include "common.h"
+#include "wire.h"
 
 // ---------- helpers ----------
 std::string hbQueue(int id) {
@@ -16,6 +18,22 @@ std::string sensorQueue(int id) {
     return "/mq_sensor_" + std::to_string(id);
 }
 
+// ---------- flat distance table ----------
+// sorted by truck id; capacity reserved up front so the tick loop never allocates
+struct DistanceEntry {
+    int truckId;
+    double distance;
+};
+
+void setDistance(std::vector<DistanceEntry>& table, int truckId, double distance) {
+    auto it = std::lower_bound(table.begin(), table.end(), truckId,
+                               [](const DistanceEntry& e, int id) { return e.truckId < id; });
+    if (it != table.end() && it->truckId == truckId)
+        it->distance = distance;
+    else if (table.size() < table.capacity())
+        table.insert(it, DistanceEntry{truckId, distance});
+}
+
 // ---------- follower ----------
 void runFollower(int id) {
     mqd_t mqHb = mq_open(hbQueue(id).c_str(), O_RDONLY);
@@ -35,9 +53,17 @@ void runFollower(int id) {
     leader.sin_port = htons(6001);
     inet_pton(AF_INET, "127.0.0.1", &leader.sin_addr);
 
+    WireEncoder enc;
+    wireEncoderInit(enc, (uint16_t)id);
+    WireFrame frame;
+    uint8_t rxBuf[WIRE_MAX_FRAME];
+
     // notify leader of join
     LeaderMsg join{LeaderMsgType::Join, id, 0.0};
-    sendto(udpTx, &join, sizeof(join), 0,
+    wireBegin(frame, enc, WireType::Report);
+    wirePutReport(frame, enc, join);
+    size_t len = wireFinish(frame, enc);
+    sendto(udpTx, frame.buf, len, 0,
            (sockaddr*)&leader, sizeof(leader));
 
     double speed = 20.0;
@@ -50,14 +76,16 @@ void runFollower(int id) {
         mq_receive(mqHb, (char*)&hb, sizeof(hb), nullptr);
 
         // ---- read sensors ----
-        SensorMsg s;
-        while (mq_receive(mqSn, (char*)&s, sizeof(s), nullptr) > 0)
-            actualDistance = s.distanceToFront;
+        ssize_t n;
+        while ((n = mq_receive(mqSn, (char*)rxBuf, sizeof(rxBuf), nullptr)) > 0) {
+            wireDecodeValue(rxBuf, n, WireType::Sensor, actualDistance);
+        }
 
         // ---- read setpoint ----
-        SetpointMsg sp;
-        recvfrom(udpRx, &sp, sizeof(sp), MSG_DONTWAIT, nullptr, nullptr);
-        desiredDistance = sp.desiredDistance;
+        while ((n = recvfrom(udpRx, rxBuf, sizeof(rxBuf), MSG_DONTWAIT,
+                             nullptr, nullptr)) > 0) {
+            wireDecodeValue(rxBuf, n, WireType::Setpoint, desiredDistance);
+        }
 
         // ---- distance control (simple, stable) ----
         double error = actualDistance - desiredDistance;
@@ -69,10 +97,14 @@ void runFollower(int id) {
         speed += accel;
         if (speed < 0.0) speed = 0.0;
 
-        // ---- report distance ----
+        // ---- report distance (skipped when unchanged) ----
         LeaderMsg d{LeaderMsgType::Distance, id, actualDistance};
-        sendto(udpTx, &d, sizeof(d), 0,
-               (sockaddr*)&leader, sizeof(leader));
+        wireBegin(frame, enc, WireType::Report);
+        wirePutReport(frame, enc, d);
+        len = wireFinish(frame, enc);
+        if (len > 0)
+            sendto(udpTx, frame.buf, len, 0,
+                   (sockaddr*)&leader, sizeof(leader));
 
         std::cout << "[Follower " << id << "] "
                   << "speed=" << speed
@@ -99,7 +131,12 @@ void runLeader(int id) {
     bind(udpRx, (sockaddr*)&rx, sizeof(rx));
 
     double desiredDistance = 20.0;
-    std::map<int, double> distances;
+    std::vector<DistanceEntry> distances;
+    distances.reserve(WIRE_MAX_TRUCKS);
+
+    WireDecoder dec;
+    wireDecoderInit(dec);
+    uint8_t rxBuf[WIRE_MAX_FRAME];
 
     while (true) {
         Heartbeat hb;
@@ -112,17 +149,26 @@ void runLeader(int id) {
             if (c == '-') desiredDistance -= 1.0;
         }
 
-        SetpointMsg sp{desiredDistance};
-        sendto(udpTx, &sp, sizeof(sp), 0,
+        uint8_t setpoint[WIRE_MAX_VALUE_FRAME];
+        size_t len = wireEncodeValue(setpoint, WireType::Setpoint, desiredDistance);
+        sendto(udpTx, setpoint, len, 0,
                (sockaddr*)&tx, sizeof(tx));
 
-        LeaderMsg msg;
-        while (recvfrom(udpRx, &msg, sizeof(msg),
-                        MSG_DONTWAIT, nullptr, nullptr) > 0) {
-            if (msg.type == LeaderMsgType::Join)
-                distances[msg.truckId] = 0.0;
-            if (msg.type == LeaderMsgType::Distance)
-                distances[msg.truckId] = msg.distance;
+        // one datagram may carry reports for many trucks
+        ssize_t n;
+        while ((n = recvfrom(udpRx, rxBuf, sizeof(rxBuf),
+                             MSG_DONTWAIT, nullptr, nullptr)) > 0) {
+            WireView v;
+            if (!wireParse(dec, rxBuf, n, v) || v.type != WireType::Report)
+                continue;
+
+            LeaderMsg msg;
+            while (wireNextReport(dec, v, msg)) {
+                if (msg.type == LeaderMsgType::Join)
+                    setDistance(distances, msg.truckId, 0.0);
+                if (msg.type == LeaderMsgType::Distance)
+                    setDistance(distances, msg.truckId, msg.distance);
+            }
         }
 
         // ---- ASCII visualization ----
@@ -134,9 +180,9 @@ void runLeader(int id) {
 
         for (auto& p : distances) {
             std::cout << "   == "
-                      << std::setw(4) << (int)p.second
+                      << std::setw(4) << (int)p.distance
                       << " m ==   | Truck "
-                      << p.first << " |";
+                      << p.truckId << " |";
         }
         std::cout << "\n";
     }
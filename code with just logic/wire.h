@@ -0,0 +1,356 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cmath>
+#include "common.h"
+
+// ========== Platoon Wire Format ==========
+//
+// Report datagrams are full frames:
+//
+//   [version:1][type:1][flags:1][count:1][source:2][seq:2][checksum:2][records...]
+//
+// Multi-byte header fields are little-endian. Distances and speeds travel as
+// centimetres in zigzag varints. Report frames are delta-encoded against the
+// previous frame of the same source. Every WIRE_KEYFRAME_INTERVAL-th frame begun
+// is a full keyframe and is sent even if nothing changed, so a receiver that
+// starts late still resyncs. In between, records whose value did not change
+// are left out, so many trucks can share one datagram cheaply.
+//
+// Setpoint and sensor messages carry a single number to one receiver and
+// need no sequence or delta state, so they use a short value frame instead:
+//
+//   [version:4|type:4][value varint][check:1]
+//
+// 3-5 bytes for any realistic distance, against 8 for the raw double. The
+// first byte never equals WIRE_VERSION, so the two kinds cannot be confused.
+
+const uint8_t WIRE_VERSION = 1;
+const size_t WIRE_HEADER_SIZE = 10;
+const size_t WIRE_MAX_FRAME = 1400;          // fits one Ethernet MTU
+const uint8_t WIRE_FLAG_KEYFRAME = 0x01;
+const int WIRE_KEYFRAME_INTERVAL = 10;
+const int WIRE_MAX_TRUCKS = 64;              // delta table size per encoder/decoder
+const int WIRE_MAX_STREAMS = 16;             // senders a decoder tracks
+const size_t WIRE_MAX_VALUE_FRAME = 7;       // tag + 5-byte varint + check
+
+enum class WireType : uint8_t {
+    Report = 1,     // LeaderMsg records, follower -> leader (full frame)
+    Setpoint = 2,   // SetpointMsg, leader -> followers (value frame)
+    Sensor = 3      // SensorMsg, main frame -> truck (value frame)
+};
+
+// Report record kind byte: low bits = LeaderMsgType, this bit = value is a delta
+const uint8_t WIRE_RECORD_DELTA = 0x80;
+
+// ---------- frame buffers ----------
+
+struct WireFrame {
+    uint8_t buf[WIRE_MAX_FRAME];
+    size_t len;
+    uint8_t count;
+    bool keyframe;
+};
+
+struct WireView {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+    WireType type;
+    uint8_t count;
+    uint16_t source;
+    uint16_t seq;
+    bool keyframe;
+    bool deltas_ok;     // stream had no gap since its last keyframe
+};
+
+// Last value per truck, used as the delta base on both ends
+struct WireDeltaEntry {
+    int truckId;
+    int32_t last_cm;
+    bool valid;
+};
+
+struct WireDeltaTable {
+    WireDeltaEntry entries[WIRE_MAX_TRUCKS];
+    int used;
+};
+
+struct WireEncoder {
+    uint16_t source;
+    uint16_t seq;                // advances per frame sent
+    int since_keyframe;          // frames begun since the last keyframe
+    WireDeltaTable deltas;
+};
+
+struct WireStream {
+    uint16_t source;
+    uint16_t last_seq;
+    bool synced;
+};
+
+struct WireDecoder {
+    WireStream streams[WIRE_MAX_STREAMS];
+    int stream_count;
+    WireDeltaTable values;
+};
+
+// ---------- primitives ----------
+
+// Fletcher-16 over the whole frame, with the checksum field itself read as zero
+inline uint16_t wireChecksum(const uint8_t* data, size_t len) {
+    uint16_t a = 0, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = (i == 8 || i == 9) ? 0 : data[i];
+        a = (a + byte) % 255;
+        b = (b + a) % 255;
+    }
+    return (uint16_t)((b << 8) | a);
+}
+
+inline void wirePut16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+}
+
+inline uint16_t wireGet16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t wireZigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline int32_t wireUnzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+inline bool wirePutVarint(WireFrame& f, uint32_t v) {
+    while (v >= 0x80) {
+        if (f.len >= WIRE_MAX_FRAME) return false;
+        f.buf[f.len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    if (f.len >= WIRE_MAX_FRAME) return false;
+    f.buf[f.len++] = (uint8_t)v;
+    return true;
+}
+
+inline bool wireGetVarint(WireView& v, uint32_t& out) {
+    out = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (v.pos >= v.len) return false;
+        uint8_t byte = v.data[v.pos++];
+        out |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;   // over-long varint
+}
+
+inline int32_t wireToCm(double metres) {
+    return (int32_t)std::lround(metres * 100.0);
+}
+
+inline double wireFromCm(int32_t cm) {
+    return cm / 100.0;
+}
+
+inline WireDeltaEntry* wireDeltaFind(WireDeltaTable& t, int truckId) {
+    for (int i = 0; i < t.used; i++) {
+        if (t.entries[i].truckId == truckId) return &t.entries[i];
+    }
+    if (t.used >= WIRE_MAX_TRUCKS) return nullptr;
+
+    WireDeltaEntry* e = &t.entries[t.used++];
+    e->truckId = truckId;
+    e->last_cm = 0;
+    e->valid = false;
+    return e;
+}
+
+// ---------- encoding ----------
+
+inline void wireEncoderInit(WireEncoder& enc, uint16_t source) {
+    enc.source = source;
+    enc.seq = 0;
+    enc.since_keyframe = 0;
+    enc.deltas.used = 0;
+}
+
+// Keyframes are counted in frames begun, not frames sent: a source whose
+// values never change sends nothing else, so they must not depend on seq.
+inline void wireBegin(WireFrame& f, WireEncoder& enc, WireType type) {
+    f.keyframe = (type != WireType::Report) || enc.since_keyframe == 0;
+    if (type == WireType::Report) enc.since_keyframe = (enc.since_keyframe + 1) % WIRE_KEYFRAME_INTERVAL;
+    f.buf[0] = WIRE_VERSION;
+    f.buf[1] = (uint8_t)type;
+    f.buf[2] = f.keyframe ? WIRE_FLAG_KEYFRAME : 0;
+    f.buf[3] = 0;
+    wirePut16(f.buf + 4, enc.source);
+    wirePut16(f.buf + 6, enc.seq);
+    wirePut16(f.buf + 8, 0);
+    f.len = WIRE_HEADER_SIZE;
+    f.count = 0;
+}
+
+// Append one truck report. Unchanged distances are skipped between keyframes.
+// Returns false if the frame is full (caller should finish and send it).
+inline bool wirePutReport(WireFrame& f, WireEncoder& enc, const LeaderMsg& m) {
+    if (f.count == 255) return false;
+
+    WireDeltaEntry* e = wireDeltaFind(enc.deltas, m.truckId);
+    int32_t cm = wireToCm(m.distance);
+    bool delta = !f.keyframe && e && e->valid && m.type == LeaderMsgType::Distance;
+
+    if (delta && cm == e->last_cm) return true;
+
+    size_t mark = f.len;
+    uint8_t kind = (uint8_t)m.type | (delta ? WIRE_RECORD_DELTA : 0);
+    int32_t value = delta ? cm - e->last_cm : cm;
+
+    if (f.len >= WIRE_MAX_FRAME) return false;
+    f.buf[f.len++] = kind;
+    if (!wirePutVarint(f, (uint32_t)m.truckId) || !wirePutVarint(f, wireZigzag(value))) {
+        f.len = mark;
+        return false;
+    }
+
+    if (e) {
+        e->last_cm = cm;
+        e->valid = true;
+    }
+    f.count++;
+    return true;
+}
+
+// Seal the frame. Returns its length, or 0 if there is nothing worth sending.
+inline size_t wireFinish(WireFrame& f, WireEncoder& enc) {
+    if (f.count == 0 && !f.keyframe) return 0;
+
+    f.buf[3] = f.count;
+    wirePut16(f.buf + 8, wireChecksum(f.buf, f.len));
+    enc.seq++;
+    return f.len;
+}
+
+// ---------- decoding ----------
+
+inline void wireDecoderInit(WireDecoder& dec) {
+    dec.stream_count = 0;
+    dec.values.used = 0;
+}
+
+// Validate header and checksum, and track per-source sequence gaps
+inline bool wireParse(WireDecoder& dec, const uint8_t* data, size_t len, WireView& v) {
+    if (len < WIRE_HEADER_SIZE || len > WIRE_MAX_FRAME) return false;
+    if (data[0] != WIRE_VERSION) return false;
+    if (wireChecksum(data, len) != wireGet16(data + 8)) return false;
+
+    v.data = data;
+    v.len = len;
+    v.pos = WIRE_HEADER_SIZE;
+    v.type = (WireType)data[1];
+    v.keyframe = (data[2] & WIRE_FLAG_KEYFRAME) != 0;
+    v.count = data[3];
+    v.source = wireGet16(data + 4);
+    v.seq = wireGet16(data + 6);
+
+    WireStream* s = nullptr;
+    for (int i = 0; i < dec.stream_count; i++) {
+        if (dec.streams[i].source == v.source) s = &dec.streams[i];
+    }
+    if (!s && dec.stream_count < WIRE_MAX_STREAMS) {
+        s = &dec.streams[dec.stream_count++];
+        s->source = v.source;
+        s->synced = false;
+    }
+
+    if (!s) {
+        v.deltas_ok = false;
+    } else {
+        if (v.keyframe) {
+            s->synced = true;
+        } else if (s->synced && v.seq != (uint16_t)(s->last_seq + 1)) {
+            s->synced = false;   // lost a frame: ignore deltas until next keyframe
+        }
+        s->last_seq = v.seq;
+        v.deltas_ok = s->synced;
+    }
+    return true;
+}
+
+// Next report record. Delta records without a trusted base are skipped.
+inline bool wireNextReport(WireDecoder& dec, WireView& v, LeaderMsg& out) {
+    while (v.pos < v.len) {
+        uint8_t kind = v.data[v.pos++];
+        uint32_t id, raw;
+        if (!wireGetVarint(v, id) || !wireGetVarint(v, raw)) return false;
+
+        bool delta = (kind & WIRE_RECORD_DELTA) != 0;
+        WireDeltaEntry* e = wireDeltaFind(dec.values, (int)id);
+        int32_t value = wireUnzigzag(raw);
+
+        if (delta) {
+            if (!v.deltas_ok || !e || !e->valid) continue;
+            value += e->last_cm;
+        }
+        if (e) {
+            e->last_cm = value;
+            e->valid = true;
+        }
+
+        out.type = (LeaderMsgType)(kind & ~WIRE_RECORD_DELTA);
+        out.truckId = (int)id;
+        out.distance = wireFromCm(value);
+        return true;
+    }
+    return false;
+}
+
+// ---------- value frames ----------
+
+inline uint8_t wireValueTag(WireType type) {
+    return (uint8_t)((WIRE_VERSION << 4) | ((uint8_t)type & 0x0F));
+}
+
+// CRC-8 (poly 0x07): catches every single-bit and burst-up-to-8 error
+inline uint8_t wireCheck8(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Encode into buf (at least WIRE_MAX_VALUE_FRAME bytes); returns the length
+inline size_t wireEncodeValue(uint8_t* buf, WireType type, double metres) {
+    uint32_t v = wireZigzag(wireToCm(metres));
+    size_t len = 0;
+    buf[len++] = wireValueTag(type);
+    while (v >= 0x80) {
+        buf[len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[len++] = (uint8_t)v;
+    buf[len] = wireCheck8(buf, len);
+    return len + 1;
+}
+
+inline bool wireDecodeValue(const uint8_t* data, size_t len, WireType type, double& metres) {
+    if (len < 3 || len > WIRE_MAX_VALUE_FRAME) return false;
+    if (data[0] != wireValueTag(type)) return false;
+    if (wireCheck8(data, len - 1) != data[len - 1]) return false;
+
+    WireView v{data, len - 1, 1, type, 1, 0, 0, true, true};
+    uint32_t raw;
+    if (!wireGetVarint(v, raw) || v.pos != v.len) return false;
+    metres = wireFromCm(wireUnzigzag(raw));
+    return true;
+}
+
+#endif